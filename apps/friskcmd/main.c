@@ -1,18 +1,893 @@
 #include "friskContext.h"
+#include "friskEncoding.h"
+#include "friskFind.h"
+#include "friskPool.h"
+#include "friskRender.h"
+#include "friskView.h"
+
+#include "dynArray.h"
+#include "dynString.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef FRISK_PLATFORM_WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static void usage()
+{
+    printf("Usage: friskcmd [options] PATTERN [PATH...]\n");
+    printf("       friskcmd [options] -e PATTERN [-e PATTERN...] [PATH...]\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("    -e PATTERN   Add a pattern to search for (can be repeated)\n");
+    printf("    -f FILE      Read patterns from FILE, one per line\n");
+    printf("    -x           Patterns are regexes\n");
+    printf("    -s           Case sensitive match\n");
+    printf("    -U           Let hits span lines (regexes get multiline and dotall)\n");
+    printf("    -u           Treat patterns and files as UTF-8 (skips files that aren't)\n");
+    printf("    -z           Search inside gzip/zstd/xz compressed files\n");
+    printf("    -a           Search inside zip/jar/tar archives (hits show up as archive!/path)\n");
+    printf("    -g FILESPEC  Only search files matching FILESPEC (semicolon-delimited, can be repeated)\n");
+    printf("    -N           Don't recurse into subdirectories\n");
+    printf("    --exclude FILESPEC      Skip files matching FILESPEC (semicolon-delimited, can be repeated)\n");
+    printf("    --exclude-dir FILESPEC  Don't descend into directories matching FILESPEC\n");
+    printf("    --no-ignore  Search files that .gitignore/.ignore/.friskignore would skip\n");
+    printf("    --sort       Print results in path order, the same every run\n");
+    printf("    --json       Print results as JSON Lines, ending with a stats record\n");
+    printf("    --binary     Print results as length-prefixed binary records (see main.c)\n");
+    printf("    --color WHEN Colour the hits: auto (when stdout is a terminal), always or never\n");
+    printf("    --page N     Print only page N of the result rows, once the search is done\n");
+    printf("    --page-size N          Rows per page for --page (default: 50)\n");
+    printf("    --find TEXT  Once the search is done, find TEXT in the result rows\n");
+    printf("    --find-regex REGEX     Same, with a regex\n");
+    printf("    --find-case  --find is case sensitive\n");
+    printf("    --find-words --find only matches whole words\n");
+    printf("    -l           Only list the files with hits\n");
+    printf("    -c           Only print the number of hits in each file\n");
+    printf("    -m SIZE      Skip files larger than SIZE kilobytes\n");
+    printf("    --min-size SIZE        Skip files smaller than SIZE kilobytes\n");
+    printf("    --newer-than MINUTES   Only search files modified in the last MINUTES minutes\n");
+    printf("    --older-than MINUTES   Only search files last modified more than MINUTES minutes ago\n");
+    printf("    --max-depth N          Only search N levels deep (1 is just the files in PATH)\n");
+    printf("    -A N         Show N lines of context after each hit\n");
+    printf("    -B N         Show N lines of context before each hit\n");
+    printf("    -C N         Show N lines of context around each hit\n");
+    printf("    --match-limit N        PCRE match_limit (default: PCRE's)\n");
+    printf("    --recursion-limit N    PCRE match_limit_recursion (default: PCRE's)\n");
+    printf("    --file-timeout MS      Give up on any one file after MS milliseconds (checked between\n");
+    printf("                           lines; --match-limit bounds a single regex run)\n");
+    printf("    --max-count N          Stop looking at a file after N hits\n");
+    printf("    --max-hits N           Stop the search after N hits in total\n");
+    printf("    --max-files N          Stop the search after N files with hits\n");
+    printf("    -j N         Search N files at a time (default: one per core)\n");
+    printf("    --affinity POLICY      Where search threads run: float (default), cores or numa\n");
+    printf("    --read-depth N         Read up to N files ahead of the search threads (default: 64, 0 for none)\n");
+    printf("    --io HINTS   Comma-separated: inode (search each directory in inode order), readahead,\n");
+    printf("                 nocache (keep files of 32MB and up out of the page cache)\n");
+}
+
+static void split(const char *orig, char sep, char ***output)
+{
+    const char *front = orig;
+    while(*front)
+    {
+        const char *end = strchr(front, sep);
+        if(!end)
+            end = front + strlen(front);
+        if(end > front)
+        {
+            char *token = NULL;
+            dsCopyLen(&token, front, (int)(end - front));
+            daPush(output, token);
+        }
+        front = *end ? end + 1 : end;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Output. Results are written as each file finishes, through one big stdio buffer that's flushed
+// when it fills or OUTPUT_FLUSH_MS after the last flush, whichever comes first.
+//
+// --json writes one JSON object per line (JSON Lines). Every object has a "type":
+//   match    file, line, end_line, offset (of the line in the file), text, spans (start/length/
+//            pattern, relative to text)
+//   context  file, line, text
+//   count    file, hits        (-c)
+//   file     file              (-l)
+//   skipped  file, reason
+//   warning  text
+//   stats    the search's counters and whether a hit limit truncated it; always the last record
+// Bytes that aren't valid UTF-8 are written as the Latin-1 character with the same value.
+//
+// --binary writes the same records as frames: a type byte ('M', 'C', 'N', 'F', 'S', 'W', 'T' in
+// the order above), the payload length as a little-endian u32, then the payload. Payload integers
+// are little-endian u32s and strings are a u32 length followed by that many bytes (no NUL):
+//   M  file line end_line offset text span_count (start length pattern)*
+//   C  file line text
+//   N  file hits
+//   F  file
+//   S  file reason
+//   W  text
+//   T  directories_searched directories_skipped files_searched files_skipped files_with_hits
+//      lines_with_hits hits truncated elapsed_ms
+//
+// --page N prints rows of the results through friskView instead (see friskView.h), once the
+// search is done: "row" records in JSON (index, file, line, context, text, spans) and 'R' frames
+// (index file line context text span_count (start length pattern)*) in binary. --find looks
+// through those same rows afterwards (see friskFind.h): "find" records (row, file, line, offset,
+// length, text) and 'H' frames (row file line offset length text).
+
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+#define OUTPUT_FLUSH_MS (100)
+
+typedef enum outputFormat
+{
+    OF_TEXT = 0,
+    OF_JSON,
+    OF_BINARY,
+
+    OF_COUNT
+} outputFormat;
+
+typedef struct outputState
+{
+    outputFormat format;
+    const char *lastFile; // text: where the last context group ended, for the "--" separators
+    int lastLine;
+    unsigned long long lastFlush;
+    char *frame;          // binary: the payload being built
+    int frameSize;
+    int frameCapacity;
+    friskRenderer *renderer; // text with --color: colours the hits in each line
+} outputState;
+
+static void jsonEscape(const char *s, int len)
+{
+    const char *run = s;
+    const char *end = s + len;
+    for(; s < end; ++s)
+    {
+        unsigned char c = (unsigned char)*s;
+        if((c >= 0x20) && (c != '"') && (c != '\\'))
+            continue;
+        fwrite(run, 1, s - run, stdout);
+        run = s + 1;
+        if(c == '"')
+            fputs("\\\"", stdout);
+        else if(c == '\\')
+            fputs("\\\\", stdout);
+        else if(c == '\n')
+            fputs("\\n", stdout);
+        else if(c == '\r')
+            fputs("\\r", stdout);
+        else if(c == '\t')
+            fputs("\\t", stdout);
+        else
+            printf("\\u%04x", c);
+    }
+    fwrite(run, 1, end - run, stdout);
+}
+
+static void jsonString(const char *s, int len)
+{
+    putchar('"');
+    while(len > 0)
+    {
+        int bad = friskValidateUtf8(s, len);
+        if(bad < 0)
+        {
+            jsonEscape(s, len);
+            break;
+        }
+        jsonEscape(s, bad);
+        printf("\\u%04x", (unsigned char)s[bad]);
+        s += bad + 1;
+        len -= bad + 1;
+    }
+    putchar('"');
+}
+
+static void jsonField(const char *name, const char *value)
+{
+    printf(",\"%s\":", name);
+    jsonString(value ? value : "", value ? (int)strlen(value) : 0);
+}
+
+static void frameBytes(outputState *output, const void *data, int len)
+{
+    if(len <= 0)
+        return;
+    if(output->frameSize + len > output->frameCapacity)
+    {
+        output->frameCapacity = (output->frameSize + len) * 2;
+        output->frame = (char *)realloc(output->frame, output->frameCapacity);
+    }
+    memcpy(output->frame + output->frameSize, data, len);
+    output->frameSize += len;
+}
+
+static void frameU32(outputState *output, unsigned int value)
+{
+    unsigned char bytes[4];
+    bytes[0] = (unsigned char)(value);
+    bytes[1] = (unsigned char)(value >> 8);
+    bytes[2] = (unsigned char)(value >> 16);
+    bytes[3] = (unsigned char)(value >> 24);
+    frameBytes(output, bytes, 4);
+}
+
+static void frameString(outputState *output, const char *s)
+{
+    int len = s ? (int)strlen(s) : 0;
+    frameU32(output, len);
+    frameBytes(output, s, len);
+}
+
+static void frameWrite(outputState *output, char type)
+{
+    unsigned char header[5];
+    int size = output->frameSize;
+    header[0] = (unsigned char)type;
+    header[1] = (unsigned char)(size);
+    header[2] = (unsigned char)(size >> 8);
+    header[3] = (unsigned char)(size >> 16);
+    header[4] = (unsigned char)(size >> 24);
+    fwrite(header, 1, 5, stdout);
+    fwrite(output->frame, 1, size, stdout);
+    output->frameSize = 0;
+}
+
+static void writeContextLine(outputState *output, const char *filename, int line, const char *text)
+{
+    if(output->format == OF_JSON)
+    {
+        printf("{\"type\":\"context\"");
+        jsonField("file", filename);
+        printf(",\"line\":%d", line);
+        jsonField("text", text);
+        printf("}\n");
+    }
+    else if(output->format == OF_BINARY)
+    {
+        frameString(output, filename);
+        frameU32(output, line);
+        frameString(output, text);
+        frameWrite(output, 'C');
+    }
+    else
+    {
+        printf("%s(%d)- %s\n", filename, line, text);
+    }
+}
+
+static void writeMatch(outputState *output, friskEntry *entry)
+{
+    int j;
+    if(output->format == OF_JSON)
+    {
+        printf("{\"type\":\"match\"");
+        jsonField("file", entry->filename);
+        printf(",\"line\":%d,\"end_line\":%d,\"offset\":%d", entry->line, entry->endLine, entry->offset);
+        jsonField("text", entry->match);
+        printf(",\"spans\":[");
+        for(j = 0; j < daSize(&entry->highlights); ++j)
+        {
+            friskHighlight *highlight = entry->highlights[j];
+            printf("%s{\"start\":%d,\"length\":%d,\"pattern\":%d}", j ? "," : "", highlight->offset, highlight->count, highlight->pattern);
+        }
+        printf("]}\n");
+    }
+    else if(output->format == OF_BINARY)
+    {
+        frameString(output, entry->filename);
+        frameU32(output, entry->line);
+        frameU32(output, entry->endLine);
+        frameU32(output, entry->offset);
+        frameString(output, entry->match);
+        frameU32(output, daSize(&entry->highlights));
+        for(j = 0; j < daSize(&entry->highlights); ++j)
+        {
+            frameU32(output, entry->highlights[j]->offset);
+            frameU32(output, entry->highlights[j]->count);
+            frameU32(output, entry->highlights[j]->pattern);
+        }
+        frameWrite(output, 'M');
+    }
+    else
+    {
+        const char *text = entry->match;
+        if(output->renderer)
+        {
+            friskRendererClear(output->renderer);
+            friskRendererAppendEntry(output->renderer, entry->match, (int)strlen(entry->match), entry->highlights, daSize(&entry->highlights));
+            text = output->renderer->output;
+        }
+        if(entry->endLine > entry->line)
+            printf("%s(%d-%d): %s\n", entry->filename, entry->line, entry->endLine, text);
+        else
+            printf("%s(%d): %s\n", entry->filename, entry->line, text);
+    }
+}
+
+// Context lines are marked with '-' instead of ':', and "--" separates groups that aren't adjacent
+static void writeEntry(outputState *output, friskEntry *entry, friskParams *params)
+{
+    int first = entry->line - daSize(&entry->before);
+    int j;
+
+    if(params->flags & FSF_FILES_WITH_HITS)
+    {
+        if(output->format == OF_JSON)
+        {
+            printf("{\"type\":\"file\"");
+            jsonField("file", entry->filename);
+            printf("}\n");
+        }
+        else if(output->format == OF_BINARY)
+        {
+            frameString(output, entry->filename);
+            frameWrite(output, 'F');
+        }
+        else
+        {
+            printf("%s\n", entry->filename);
+        }
+        return;
+    }
+    if(params->flags & FSF_COUNT_HITS)
+    {
+        if(output->format == OF_JSON)
+        {
+            printf("{\"type\":\"count\"");
+            jsonField("file", entry->filename);
+            printf(",\"hits\":%d}\n", entry->hits);
+        }
+        else if(output->format == OF_BINARY)
+        {
+            frameString(output, entry->filename);
+            frameU32(output, entry->hits);
+            frameWrite(output, 'N');
+        }
+        else
+        {
+            printf("%s:%d\n", entry->filename, entry->hits);
+        }
+        return;
+    }
+
+    if((output->format == OF_TEXT) && ((params->contextBefore > 0) || (params->contextAfter > 0)))
+    {
+        if(output->lastFile && (strcmp(output->lastFile, entry->filename) || (first > output->lastLine + 1)))
+            printf("--\n");
+    }
+    for(j = 0; j < daSize(&entry->before); ++j)
+        writeContextLine(output, entry->filename, first + j, entry->before[j]);
+    writeMatch(output, entry);
+    for(j = 0; j < daSize(&entry->after); ++j)
+        writeContextLine(output, entry->filename, entry->line + 1 + j, entry->after[j]);
+    output->lastFile = entry->filename;
+    output->lastLine = entry->endLine + daSize(&entry->after);
+}
+
+static void writeRow(outputState *output, friskRow *row, int index)
+{
+    int j;
+    if(output->format == OF_JSON)
+    {
+        printf("{\"type\":\"row\",\"index\":%d", index);
+        jsonField("file", row->filename);
+        printf(",\"line\":%d,\"context\":%s,\"text\":", row->line, row->isContext ? "true" : "false");
+        jsonString(row->text, row->length);
+        printf(",\"spans\":[");
+        for(j = 0; j < row->highlightCount; ++j)
+            printf("%s{\"start\":%d,\"length\":%d,\"pattern\":%d}", j ? "," : "", row->highlights[j].offset, row->highlights[j].count, row->highlights[j].pattern);
+        printf("]}\n");
+    }
+    else if(output->format == OF_BINARY)
+    {
+        frameU32(output, index);
+        frameString(output, row->filename);
+        frameU32(output, row->line);
+        frameU32(output, row->isContext);
+        frameU32(output, row->length);
+        frameBytes(output, row->text, row->length);
+        frameU32(output, row->highlightCount);
+        for(j = 0; j < row->highlightCount; ++j)
+        {
+            frameU32(output, row->highlights[j].offset);
+            frameU32(output, row->highlights[j].count);
+            frameU32(output, row->highlights[j].pattern);
+        }
+        frameWrite(output, 'R');
+    }
+    else
+    {
+        printf("%s(%d)%s ", row->filename, row->line, row->isContext ? "-" : ":");
+        if(output->renderer)
+        {
+            friskRendererClear(output->renderer);
+            friskRendererAppend(output->renderer, row->text, row->length, row->highlights, row->highlightCount);
+            fwrite(output->renderer->output, 1, output->renderer->length, stdout);
+        }
+        else
+        {
+            fwrite(row->text, 1, row->length, stdout);
+        }
+        putchar('\n');
+    }
+}
+
+// Prints one page of rows, the way a frontend would fetch just what's on screen
+static void writePage(outputState *output, friskContext *context, int page, int pageSize)
+{
+    friskView *view = friskViewCreate(context);
+    friskRow *rows;
+    int first = (page - 1) * pageSize;
+    int total = friskViewRowCount(view);
+    int count = friskViewGetRows(view, first, pageSize, &rows);
+    int i;
+    for(i = 0; i < count; ++i)
+        writeRow(output, &rows[i], first + i);
+    fflush(stdout);
+    fprintf(stderr, "Page %d of %d (rows %d-%d of %d)\n", page, (total + pageSize - 1) / pageSize, count ? (first + 1) : 0, count ? (first + count) : 0, total);
+    friskViewDestroy(view);
+}
+
+// Runs a find-in-results over every row, the way a frontend's find box would
+static void writeFindHits(outputState *output, friskContext *context, const char *pattern, int flags)
+{
+    friskFind *find = friskFindCreate(context);
+    friskView *view = friskViewCreate(context);
+    friskFindHit *hits;
+    char *error = NULL;
+    int count = friskFindAll(find, pattern, flags, &hits, &error);
+    int i;
+    if(count < 0)
+    {
+        fprintf(stderr, "Bad find regex: %s\n", error);
+        dsDestroy(&error);
+    }
+    for(i = 0; i < count; ++i)
+    {
+        friskRow *row;
+        friskViewGetRows(view, hits[i].row, 1, &row);
+        if(output->format == OF_JSON)
+        {
+            printf("{\"type\":\"find\",\"row\":%d", hits[i].row);
+            jsonField("file", row->filename);
+            printf(",\"line\":%d,\"offset\":%d,\"length\":%d,\"text\":", row->line, hits[i].offset, hits[i].length);
+            jsonString(row->text, row->length);
+            printf("}\n");
+        }
+        else if(output->format == OF_BINARY)
+        {
+            frameU32(output, hits[i].row);
+            frameString(output, row->filename);
+            frameU32(output, row->line);
+            frameU32(output, hits[i].offset);
+            frameU32(output, hits[i].length);
+            frameU32(output, row->length);
+            frameBytes(output, row->text, row->length);
+            frameWrite(output, 'H');
+        }
+        else
+        {
+            printf("%s(%d)[%d]: ", row->filename, row->line, hits[i].offset + 1);
+            if(output->renderer)
+            {
+                friskHighlight highlight;
+                highlight.offset = hits[i].offset;
+                highlight.count = hits[i].length;
+                highlight.pattern = 0;
+                friskRendererClear(output->renderer);
+                friskRendererAppend(output->renderer, row->text, row->length, &highlight, 1);
+                fwrite(output->renderer->output, 1, output->renderer->length, stdout);
+            }
+            else
+            {
+                fwrite(row->text, 1, row->length, stdout);
+            }
+            putchar('\n');
+        }
+    }
+    fflush(stdout);
+    if(count >= 0)
+        fprintf(stderr, "Found %d in %d rows\n", count, friskViewRowCount(view));
+    friskViewDestroy(view);
+    friskFindDestroy(find);
+}
+
+static void onResults(friskContext *context, int first, void *userData)
+{
+    outputState *output = (outputState *)userData;
+    unsigned long long now;
+    int i;
+    for(i = first; i < daSize(&context->list); ++i)
+        writeEntry(output, context->list[i], context->params);
+
+    now = friskGetTickCount();
+    if(now - output->lastFlush >= OUTPUT_FLUSH_MS)
+    {
+        fflush(stdout);
+        output->lastFlush = now;
+    }
+}
+
+static void writeSummary(outputState *output, friskContext *context, unsigned long long elapsed)
+{
+    int i;
+    if(output->format == OF_TEXT)
+    {
+        fflush(stdout);
+        for(i = 0; i < daSize(&context->warnings); ++i)
+            fprintf(stderr, "%s\n", context->warnings[i]);
+        for(i = 0; i < daSize(&context->skipped); ++i)
+            fprintf(stderr, "Skipped %s: %s\n", context->skipped[i]->filename, context->skipped[i]->reason);
+        if(context->truncated)
+            fprintf(stderr, "Results truncated: a hit limit was reached (%d hits in %d files)\n", context->hits, context->filesWithHits);
+        return;
+    }
+
+    for(i = 0; i < daSize(&context->warnings); ++i)
+    {
+        if(output->format == OF_JSON)
+        {
+            printf("{\"type\":\"warning\"");
+            jsonField("text", context->warnings[i]);
+            printf("}\n");
+        }
+        else
+        {
+            frameString(output, context->warnings[i]);
+            frameWrite(output, 'W');
+        }
+    }
+    for(i = 0; i < daSize(&context->skipped); ++i)
+    {
+        if(output->format == OF_JSON)
+        {
+            printf("{\"type\":\"skipped\"");
+            jsonField("file", context->skipped[i]->filename);
+            jsonField("reason", context->skipped[i]->reason);
+            printf("}\n");
+        }
+        else
+        {
+            frameString(output, context->skipped[i]->filename);
+            frameString(output, context->skipped[i]->reason);
+            frameWrite(output, 'S');
+        }
+    }
+    if(output->format == OF_JSON)
+    {
+        printf("{\"type\":\"stats\",\"directories_searched\":%d,\"directories_skipped\":%d,\"files_searched\":%d,\"files_skipped\":%d,"
+               "\"files_with_hits\":%d,\"lines_with_hits\":%d,\"hits\":%d,\"truncated\":%s,\"elapsed_ms\":%llu}\n",
+            context->directoriesSearched, context->directoriesSkipped, context->filesSearched, context->filesSkipped,
+            context->filesWithHits, context->linesWithHits, context->hits, context->truncated ? "true" : "false", elapsed);
+    }
+    else
+    {
+        frameU32(output, context->directoriesSearched);
+        frameU32(output, context->directoriesSkipped);
+        frameU32(output, context->filesSearched);
+        frameU32(output, context->filesSkipped);
+        frameU32(output, context->filesWithHits);
+        frameU32(output, context->linesWithHits);
+        frameU32(output, context->hits);
+        frameU32(output, context->truncated);
+        frameU32(output, (unsigned int)elapsed);
+        frameWrite(output, 'T');
+    }
+    fflush(stdout);
+}
 
 int main(int argc, char **argv)
 {
-    friskConfig *context = friskConfigCreate();
-    friskConfigDefaults(context);
+    friskContext *context = friskContextCreate();
+    friskParams *params = context->params;
+    outputState output;
+    unsigned long long startTime;
+    int page = 0;
+    int pageSize = 50;
+    const char *color = "auto";
+    const char *findPattern = NULL;
+    int findFlags = 0;
+    int ret = 0;
+    int i;
+
+    memset(&output, 0, sizeof(output));
+    params->flags = FSF_RECURSIVE | FSF_IGNORE_FILES;
+    for(i = 1; i < argc; ++i)
     {
-        int i;
-        for(i = 0; i < daSize(&context->filespecs); ++i)
+        const char *arg = argv[i];
+        const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if((arg[0] != '-') || !arg[1])
+        {
+            if(!params->match && !daSize(&params->matches) && !params->matchFile)
+                dsCopy(&params->match, arg);
+            else
+                daPush(&params->paths, dsDup(arg));
+        }
+        else if(!strcmp(arg, "-e") && next)
+        {
+            daPush(&params->matches, dsDup(next));
+            ++i;
+        }
+        else if(!strcmp(arg, "-f") && next)
+        {
+            dsCopy(&params->matchFile, next);
+            ++i;
+        }
+        else if(!strcmp(arg, "-g") && next)
+        {
+            split(next, ';', &params->filespecs);
+            ++i;
+        }
+        else if(!strcmp(arg, "--exclude") && next)
+        {
+            split(next, ';', &params->excludeFilespecs);
+            ++i;
+        }
+        else if(!strcmp(arg, "--exclude-dir") && next)
+        {
+            split(next, ';', &params->excludeDirectories);
+            ++i;
+        }
+        else if(!strcmp(arg, "-m") && next)
+        {
+            params->maxFileSize = strtoull(next, NULL, 10);
+            ++i;
+        }
+        else if(!strcmp(arg, "--min-size") && next)
+        {
+            params->minFileSize = strtoull(next, NULL, 10);
+            ++i;
+        }
+        else if(!strcmp(arg, "--newer-than") && next)
+        {
+            params->modifiedAfter = (long long)time(NULL) - strtoll(next, NULL, 10) * 60;
+            ++i;
+        }
+        else if(!strcmp(arg, "--older-than") && next)
+        {
+            params->modifiedBefore = (long long)time(NULL) - strtoll(next, NULL, 10) * 60;
+            ++i;
+        }
+        else if(!strcmp(arg, "--max-depth") && next)
+        {
+            params->maxDepth = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "-A") && next)
+        {
+            params->contextAfter = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "-B") && next)
+        {
+            params->contextBefore = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "-C") && next)
+        {
+            params->contextBefore = params->contextAfter = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "--match-limit") && next)
+        {
+            params->matchLimit = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "--recursion-limit") && next)
+        {
+            params->matchLimitRecursion = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "--file-timeout") && next)
+        {
+            params->fileTimeLimit = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "--max-count") && next)
+        {
+            params->maxHitsPerFile = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "--max-hits") && next)
+        {
+            params->maxHits = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "--max-files") && next)
+        {
+            params->maxFilesWithHits = atoi(next);
+            ++i;
+        }
+        else if((!strcmp(arg, "-j") || !strcmp(arg, "--threads")) && next)
+        {
+            params->threads = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "--read-depth") && next)
+        {
+            params->readDepth = atoi(next) ? atoi(next) : -1;
+            ++i;
+        }
+        else if(!strcmp(arg, "--io") && next)
+        {
+            char **policies = NULL;
+            int j;
+            split(next, ',', &policies);
+            for(j = 0; j < daSize(&policies); ++j)
+            {
+                if(!strcmp(policies[j], "inode"))
+                    params->ioPolicy |= FIO_INODE_ORDER;
+                else if(!strcmp(policies[j], "readahead"))
+                    params->ioPolicy |= FIO_READAHEAD;
+                else if(!strcmp(policies[j], "nocache"))
+                    params->ioPolicy |= FIO_DONT_CACHE;
+            }
+            daDestroyStrings(&policies);
+            ++i;
+        }
+        else if(!strcmp(arg, "--affinity") && next && (!strcmp(next, "float") || !strcmp(next, "cores") || !strcmp(next, "numa")))
+        {
+            if(!strcmp(next, "cores"))
+                params->threadPolicy = FTP_PIN_CORES;
+            else if(!strcmp(next, "numa"))
+                params->threadPolicy = FTP_NUMA;
+            else
+                params->threadPolicy = FTP_FLOAT;
+            ++i;
+        }
+        else if(!strcmp(arg, "-x"))
+        {
+            params->flags |= FSF_MATCH_REGEXES;
+        }
+        else if(!strcmp(arg, "-s"))
+        {
+            params->flags |= FSF_MATCH_CASE_SENSITIVE;
+        }
+        else if(!strcmp(arg, "-U"))
+        {
+            params->flags |= FSF_MULTILINE;
+        }
+        else if(!strcmp(arg, "-u"))
+        {
+            params->flags |= FSF_UTF8;
+        }
+        else if(!strcmp(arg, "-z"))
+        {
+            params->flags |= FSF_DECOMPRESS;
+        }
+        else if(!strcmp(arg, "-a"))
+        {
+            params->flags |= FSF_ARCHIVES;
+        }
+        else if(!strcmp(arg, "-l"))
+        {
+            params->flags |= FSF_FILES_WITH_HITS;
+        }
+        else if(!strcmp(arg, "-c"))
+        {
+            params->flags |= FSF_COUNT_HITS;
+        }
+        else if(!strcmp(arg, "-N"))
+        {
+            params->flags &= ~FSF_RECURSIVE;
+        }
+        else if(!strcmp(arg, "--no-ignore"))
         {
-            printf("filespec: %s\n", context->filespecs[i]);
+            params->flags &= ~FSF_IGNORE_FILES;
         }
+        else if(!strcmp(arg, "--sort"))
+        {
+            params->flags |= FSF_SORTED;
+        }
+        else if(!strcmp(arg, "--color") && next)
+        {
+            color = next;
+            ++i;
+        }
+        else if((!strcmp(arg, "--find") || !strcmp(arg, "--find-regex")) && next)
+        {
+            findPattern = next;
+            if(!strcmp(arg, "--find-regex"))
+                findFlags |= FFF_REGEX;
+            ++i;
+        }
+        else if(!strcmp(arg, "--find-case"))
+        {
+            findFlags |= FFF_CASE_SENSITIVE;
+        }
+        else if(!strcmp(arg, "--find-words"))
+        {
+            findFlags |= FFF_WHOLE_WORDS;
+        }
+        else if(!strcmp(arg, "--page") && next)
+        {
+            page = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "--page-size") && next)
+        {
+            pageSize = atoi(next);
+            ++i;
+        }
+        else if(!strcmp(arg, "--json"))
+        {
+            output.format = OF_JSON;
+        }
+        else if(!strcmp(arg, "--binary"))
+        {
+            output.format = OF_BINARY;
+        }
+        else
+        {
+            usage();
+            friskContextDestroy(context);
+            return 2;
+        }
+    }
+
+    if(!params->match && !daSize(&params->matches) && !params->matchFile)
+    {
+        usage();
+        friskContextDestroy(context);
+        return 2;
     }
-    friskConfigDestroy(context);
-    return 0;
+    if(!daSize(&params->paths))
+        daPush(&params->paths, dsDup("."));
+
+#ifdef FRISK_PLATFORM_WIN32
+    if(output.format == OF_BINARY)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+#ifdef FRISK_PLATFORM_WIN32
+    if(!strcmp(color, "auto"))
+        color = "never"; // older consoles print the escapes as-is
+#else
+    if(!strcmp(color, "auto"))
+        color = isatty(fileno(stdout)) ? "always" : "never";
+#endif
+    if((output.format == OF_TEXT) && !strcmp(color, "always"))
+        output.renderer = friskRendererCreate(FRF_ANSI);
+    if((page <= 0) && !findPattern)
+    {
+        context->onResults = onResults;
+        context->userData = &output;
+    }
+    if(pageSize <= 0)
+        pageSize = 50;
+
+    startTime = friskGetTickCount();
+    if(friskContextSearch(context))
+    {
+        if(page > 0)
+            writePage(&output, context, page, pageSize);
+        if(findPattern)
+            writeFindHits(&output, context, findPattern, findFlags);
+        writeSummary(&output, context, friskGetTickCount() - startTime);
+        ret = daSize(&context->list) ? 0 : 1;
+    }
+    else
+    {
+        fflush(stdout);
+        fprintf(stderr, "friskcmd: %s\n", context->error);
+        ret = 2;
+    }
+
+    free(output.frame);
+    if(output.renderer)
+        friskRendererDestroy(output.renderer);
+    friskContextDestroy(context);
+    return ret;
 }
@@ -18,7 +18,9 @@ FindInSearchWindow::FindInSearchWindow(HINSTANCE instance, HWND parent, HWND sea
 	, searchWindow_(searchWindow)
 	, richEditTextBufferSize_(0)
 	, richEditTextStrLen_(0)
+	, richEditTextDirty_(true)
 	, richEditText_(NULL)
+	, richEditLower_(NULL)
 	, lastSearchFailedPos_(false)
 	, dialog_(0)
 	, matchRegex_(NULL)
@@ -31,6 +33,8 @@ FindInSearchWindow::~FindInSearchWindow()
 {
 	if(matchRegex_)
 		pcre_free(matchRegex_);
+	delete [] richEditText_;
+	delete [] richEditLower_;
 
 	if (keypressHook_)
 		UnhookWindowsHookEx(keypressHook_);
@@ -38,6 +42,11 @@ FindInSearchWindow::~FindInSearchWindow()
 }
 
 
+void FindInSearchWindow::textChanged()
+{
+	richEditTextDirty_ = true;
+}
+
 bool FindInSearchWindow::findNextMatch()
 {
 	if (searchString_.empty())
@@ -51,13 +60,15 @@ bool FindInSearchWindow::findNextMatch()
 	if (!size)
 		return false;
 
-	if (richEditTextStrLen_ != size + 1) // this is a weak check, or dirty richEditTextStrLen_ when searchWindow_ changes
+	if (richEditTextDirty_)
 	{
-		if (size > richEditTextBufferSize_ + 1)
+		if (size + 1 > richEditTextBufferSize_)
 		{	// see if our buffer is big enough
 			richEditTextBufferSize_ = size + 1;
-			delete richEditText_;
+			delete [] richEditText_;
+			delete [] richEditLower_;
 			richEditText_ = new char[richEditTextBufferSize_];
+			richEditLower_ = new char[richEditTextBufferSize_];
 		}
 
 		// null terminate it for now
@@ -73,8 +84,16 @@ bool FindInSearchWindow::findNextMatch()
 		// get the text
 		SendMessage(searchWindow_, EM_GETTEXTEX, (LPARAM)&tex, (LPARAM)richEditText_);
 		richEditTextStrLen_ = strlen(richEditText_);
+		richEditTextDirty_ = false;
 		if (!richEditTextStrLen_)
 			return false;
+
+		// Fold it once here, rather than on every byte of every find
+		for (int i = 0; i <= richEditTextStrLen_; ++i)
+		{
+			char c = richEditText_[i];
+			richEditLower_[i] = (c >= 'A' && c <= 'Z') ? (c + ('a' - 'A')) : c;
+		}
 	}
 	
 	// Get the current selection, start searching from this point
@@ -93,14 +112,14 @@ bool FindInSearchWindow::findNextMatch()
 	int matchLen = 0;
 	if (matchRegex_)
 	{
-		int rc;
-		int ovector[100];
-		for (rc = 0; rc < 100; ++rc)
+		int ovector[30]; // pcre_exec wants a count of ints (a multiple of 3), not a size in bytes
+		for (int i = 0; i < 30; ++i)
 		{
-			ovector[rc] = -1;
+			ovector[i] = -1;
 		}
 
-		if(rc = pcre_exec(matchRegex_, 0, pchSearchStr, strlen(pchSearchStr), 0, 0, ovector, sizeof(ovector)) >= 0)
+		int rc = pcre_exec(matchRegex_, 0, pchSearchStr, richEditTextStrLen_ - searchOffset, 0, 0, ovector, sizeof(ovector) / sizeof(ovector[0]));
+		if(rc >= 0)
 		{
 			// check if we have a capture, only consider the first match 
 			if (ovector[2] < 0 || ovector[3] < 0)
@@ -124,7 +143,15 @@ bool FindInSearchWindow::findNextMatch()
 		}
 		else
 		{
-			pchFound = strstri(richEditText_ + searchOffset, searchString_.c_str());
+			std::string lowered = searchString_;
+			for (size_t i = 0; i < lowered.size(); ++i)
+			{
+				if (lowered[i] >= 'A' && lowered[i] <= 'Z')
+					lowered[i] += 'a' - 'A';
+			}
+			pchFound = strstr(richEditLower_ + searchOffset, lowered.c_str());
+			if (pchFound)
+				pchFound = richEditText_ + (pchFound - richEditLower_);
 		}
 
 		if (pchFound)
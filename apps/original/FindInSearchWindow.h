@@ -25,6 +25,7 @@ public:
 	
 	void optionChanged(WPARAM wParam, LPARAM lParam);
 	bool isActive();
+	void textChanged(); // searchWindow_'s text was updated, so fetch (and fold) it again
 
 protected:
 	void doFindNext();
@@ -45,8 +46,10 @@ protected:
 	SearchConfig *config_;
 
 	char* richEditText_;
+	char* richEditLower_; // richEditText_ with A-Z folded, for finds that ignore case
 	int richEditTextBufferSize_;
 	int richEditTextStrLen_;
+	bool richEditTextDirty_;
 
 	std::string searchString_;
 	pcre *matchRegex_;
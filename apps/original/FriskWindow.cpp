@@ -111,6 +111,7 @@ FriskWindow::FriskWindow(HINSTANCE instance)
 , dialog_((HWND)INVALID_HANDLE_VALUE)
 , context_(NULL)
 , pFindSearchWindow_(NULL)
+, renderer_(friskRendererCreate(FRF_RTF))
 , keypressHook_(NULL)
 , running_(false)
 , closing_(false)
@@ -128,6 +129,7 @@ FriskWindow::~FriskWindow()
 {
     DeleteObject(font_);
     delete context_;
+    friskRendererDestroy(renderer_);
 	if (keypressHook_)
 		UnhookWindowsHookEx(keypressHook_);
     sWindow = NULL;
@@ -143,6 +145,8 @@ void FriskWindow::outputClear()
     charRange.cpMax = -1;
     SendMessage(outputCtrl_, EM_EXSETSEL, 0, (LPARAM)&charRange);
     SendMessage(outputCtrl_, EM_REPLACESEL, FALSE, (LPARAM)"");
+    if (pFindSearchWindow_)
+        pFindSearchWindow_->textChanged();
 }
 
 void FriskWindow::outputUpdatePos()
@@ -325,27 +329,8 @@ INT_PTR FriskWindow::onInitDialog(HWND hDlg, WPARAM wParam, LPARAM lParam)
     return TRUE;
 }
 
-static void splitRtfHighlights(const char *rawLine, HighlightList &highlights, StringList &l)
-{
-	const char* c = rawLine;
-	for(HighlightList::iterator it = highlights.begin(); it != highlights.end(); it++)
-	{
-		Highlight &highlight = *it;
-		std::string pre(c, rawLine + it->offset);
-		l.push_back(pre);
-		std::string p(rawLine + it->offset, it->count);
-		l.push_back(p);
-		c = rawLine + it->offset + it->count;
-	}
-	if(*c)
-		l.push_back(std::string(c));
-}
-
 std::string FriskWindow::rtfHighlight(const char *rawLine, HighlightList &highlights, int count)
 {
-	StringList pieces;
-	splitRtfHighlights(rawLine, highlights, pieces);
-
 	char header[1024];
 	sprintf(header, "{\\rtf1{\\fonttbl{\\f0\\fnil\\fcharset0 Courier New;}}{\\colortbl ;\\red%d\\green%d\\blue%d;\\red%d\\green%d\\blue%d;}\\fs%d\\cf1 ",
 		(int)GetRValue(config_->textColor_),
@@ -357,23 +342,21 @@ std::string FriskWindow::rtfHighlight(const char *rawLine, HighlightList &highli
 		config_->textSize_ * 2
 		);
 
-	std::string rtf = header;
-	const char * colorTexts[2] = 
+	// Escaping and colouring happen in one pass in the renderer
+	std::vector<friskHighlight> spans(highlights.size());
+	for(size_t i = 0; i < highlights.size(); ++i)
 	{
-		"\\cf1 ",
-		"\\cf2 ",
-	};
-	int currentColor = 0;
-	for(StringList::iterator it = pieces.begin(); it != pieces.end(); ++it)
-	{
-		replaceAll(*it, "\\", "\\\\");
-		replaceAll(*it, "{", "\\{");
-		replaceAll(*it, "}", "\\}");
-		replaceAll(*it, "\n", "\\line ");
-		rtf += colorTexts[currentColor];
-		currentColor ^= 1;
-		rtf += *it;
+		spans[i].offset = highlights[i].offset;
+		spans[i].count = highlights[i].count;
+		spans[i].pattern = 0;
 	}
+	friskRendererClear(renderer_);
+	friskRendererAppend(renderer_, rawLine, (int)strlen(rawLine), spans.empty() ? NULL : &spans[0], (int)spans.size());
+
+	std::string rtf;
+	rtf.reserve(strlen(header) + renderer_->length + 1);
+	rtf = header;
+	rtf.append(renderer_->output, renderer_->length);
 	rtf += "}";
 	return rtf;
 }
@@ -430,7 +413,7 @@ INT_PTR FriskWindow::onPoke(WPARAM wParam, LPARAM lParam)
 
     updateState(pokeData->progress);
 
-    if(pokeData->text.empty())
+    if(pokeData->items.empty())
 	{
 		delete pokeData;
         return TRUE;
@@ -458,9 +441,14 @@ INT_PTR FriskWindow::onPoke(WPARAM wParam, LPARAM lParam)
     SendMessage(outputCtrl_, EM_EXSETSEL, 0, (LPARAM)&charRange);
 
     // Append the incoming text
-	std::string rtfText = rtfHighlight(pokeData->text.c_str(), pokeData->highlights, 0);
+    std::string text;
+    HighlightList highlights;
+    context_->generateDisplay(*pokeData, text, highlights);
+	std::string rtfText = rtfHighlight(text.c_str(), highlights, 0);
     SendMessage(outputCtrl_, EM_REPLACESEL, FALSE, (LPARAM)rtfText.c_str());
     delete pokeData;
+    if (pFindSearchWindow_)
+        pFindSearchWindow_->textChanged();
 
     // Move the caret/selection back to where it was, and scroll to the previous view
     SendMessage(outputCtrl_, EM_EXSETSEL, 0, (LPARAM)&prevRange);
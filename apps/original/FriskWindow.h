@@ -14,6 +14,11 @@
 
 #include "SearchContext.h"
 
+extern "C"
+{
+#include "friskRender.h"
+}
+
 class FindInSearchWindow;
 
 void comboSet(HWND ctrl, StringList &list);
@@ -106,6 +111,7 @@ protected:
 	SearchContext *context_;
     SearchConfig *config_;
 	FindInSearchWindow *pFindSearchWindow_;
+    friskRenderer *renderer_; // reused by rtfHighlight() so pokes stop reallocating
 	
     bool running_;
     bool closing_;
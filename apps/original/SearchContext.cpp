@@ -12,6 +12,10 @@
 
 #define POKES_PER_SECOND (5)
 
+// Keeps a pathological pattern from spinning on one long line forever
+#define MATCH_LIMIT (1000000)
+#define MATCH_LIMIT_RECURSION (100000)
+
 char * strstri(char * haystack, const char * needle)
 {
     char *front = haystack;
@@ -49,6 +53,9 @@ ScopedMutex::~ScopedMutex()
 // ------------------------------------------------------------------------------------------------
 
 SearchEntry::SearchEntry()
+: line_(0)
+, offset_(0)
+, trimLength_(0)
 {
 }
 
@@ -88,58 +95,56 @@ void SearchContext::clear()
     list_.clear();
 }
 
-std::string SearchContext::generateDisplay(SearchEntry &entry, int &textOffset)
+void SearchContext::generateDisplay(PokeData &pokeData, std::string &text, HighlightList &highlights)
 {
-    char middle[64];
-    sprintf(middle, "(%d): ", entry.line_);
+    ScopedMutex lock(mutex_);
 
-    std::string s = entry.filename_.c_str();
-    if(params_.flags & SF_TRIM_FILENAMES)
+    for(PokeItemList::iterator it = pokeData.items.begin(); it != pokeData.items.end(); ++it)
     {
-        std::string &startingPath = params_.paths[0];
-        if(strstri((char *)s.c_str(), startingPath.c_str()) == s.c_str())
+        if((it->entry < 0) || (it->entry >= (int)list_.size()))
         {
-            s = s.substr(startingPath.length());
-            if(s.length() && (s[0] == '\\'))
-            {
-                s.erase(s.begin());
-            }
+            text += it->message;
+            offset_ += it->message.length();
+            continue;
         }
-    }
 
-    s += middle;
-    textOffset = s.length();
-    s += entry.match_;
-    s += "\n";
-    return s;
+        SearchEntry &entry = list_[it->entry];
+        char middle[64];
+        int start = text.length();
+        text.append(entry.filename_, entry.trimLength_, std::string::npos);
+        sprintf(middle, "(%d): ", entry.line_);
+        text += middle;
+
+        int textOffset = text.length();
+        for(HighlightList::iterator highlight = entry.highlights_.begin(); highlight != entry.highlights_.end(); ++highlight)
+        {
+            highlights.push_back(Highlight(highlight->offset + textOffset, highlight->count));
+        }
+        text += entry.match_;
+        text += "\n";
+
+        offset_ += text.length() - start;
+        entry.offset_ = offset_;
+    }
 }
 
+// The search thread only stores the entry; generateDisplay() does the formatting when the UI gets
+// around to showing it
 void SearchContext::append(int id, SearchEntry &entry)
 {
     lock();
-
-    int textOffset = 0;
-    std::string str = generateDisplay(entry, textOffset);
-    offset_ += str.length();
-
-    entry.offset_ = offset_;
+    int index = list_.size();
     list_.push_back(entry);
-
     unlock();
 
-    poke(id, str, entry.highlights_, textOffset, false);
+    poke(id, index, std::string(), false);
 }
 
-void SearchContext::poke(int id, const std::string &str, HighlightList &highlights, int highlightOffset, bool finished)
+void SearchContext::poke(int id, int entry, const std::string &message, bool finished)
 {
-    if(!str.empty())
+    if((entry >= 0) || !message.empty())
     {
-        int additionalOffset = pokeData_->text.length() + highlightOffset;
-        pokeData_->text += str;
-        for(HighlightList::iterator it = highlights.begin(); it != highlights.end(); ++it)
-        {
-            pokeData_->highlights.push_back(Highlight(it->offset + additionalOffset, it->count));
-        }
+        pokeData_->items.push_back(PokeItem(entry, message));
     }
 
     if(window_ != INVALID_HANDLE_VALUE)
@@ -211,7 +216,22 @@ static char *nextToken(char **p, char sep)
     return front;
 }
 
-bool SearchContext::searchFile(int id, const std::string &filename, RegexList &filespecRegexes, pcre *matchRegex)
+// SF_TRIM_FILENAMES shows paths relative to the first search path
+static int trimLength(const std::string &filename, const SearchParams &params)
+{
+    if(!(params.flags & SF_TRIM_FILENAMES) || params.paths.empty())
+        return 0;
+
+    const std::string &startingPath = params.paths[0];
+    int length = startingPath.length();
+    if(_strnicmp(filename.c_str(), startingPath.c_str(), length))
+        return 0;
+    if((length < (int)filename.length()) && (filename[length] == '\\'))
+        length++;
+    return length;
+}
+
+bool SearchContext::searchFile(int id, const std::string &filename, RegexList &filespecRegexes, pcre *matchRegex, pcre_extra *matchExtra)
 {
     bool matchesOneFilespec = false;
     for(RegexList::iterator it = filespecRegexes.begin(); it != filespecRegexes.end(); ++it)
@@ -232,6 +252,7 @@ bool SearchContext::searchFile(int id, const std::string &filename, RegexList &f
 
     std::string workBuffer = contents;
     std::string updatedContents;
+    int trim = trimLength(filename, params_);
 
     bool atLeastOneMatch = false;
 
@@ -240,6 +261,9 @@ bool SearchContext::searchFile(int id, const std::string &filename, RegexList &f
     char *line;
     while((line = nextToken(&p, '\n')) != NULL)
     {
+        if(stop_)
+            return false;
+
         char *originalLine = line;
         std::string replacedLine;
         SearchEntry entry;
@@ -261,13 +285,25 @@ bool SearchContext::searchFile(int id, const std::string &filename, RegexList &f
 
             if(matchRegex)
             {
-                int rc;
-                if(rc = pcre_exec(matchRegex, 0, line, strlen(line), 0, 0, ovector, sizeof(ovector)) >= 0)
+                int rc = pcre_exec(matchRegex, matchExtra, line, strlen(line), 0, 0, ovector, sizeof(ovector) / sizeof(ovector[0]));
+                if(rc >= 0)
                 {
                     matches = true;
                     matchPos = ovector[0];
                     matchLen = ovector[1] - ovector[0];
                 }
+                else if((rc == PCRE_ERROR_MATCHLIMIT) || (rc == PCRE_ERROR_RECURSIONLIMIT))
+                {
+                    char buffer[64];
+                    sprintf(buffer, "%d", lineNumber);
+                    std::string err = "WARNING: Regex match limit exceeded, skipping rest of file: ";
+                    err += filename;
+                    err += "(";
+                    err += buffer;
+                    err += ")\n";
+                    poke(id, -1, err, false);
+                    return false;
+                }
             }
             else
             {
@@ -303,6 +339,7 @@ bool SearchContext::searchFile(int id, const std::string &filename, RegexList &f
                 if(matches)
                 {
                     entry.filename_ = filename;
+                    entry.trimLength_ = trim;
                     entry.match_ = originalLine;
                     entry.line_ = lineNumber;
                     entry.highlights_.push_back(Highlight(matchPos + (line - originalLine), matchLen));
@@ -332,6 +369,7 @@ bool SearchContext::searchFile(int id, const std::string &filename, RegexList &f
             if(replacedLine != originalLine)
             {
                 entry.filename_ = filename;
+                entry.trimLength_ = trim;
                 entry.match_ = replacedLine;
                 entry.line_ = lineNumber;
                 append(id, entry);
@@ -368,7 +406,7 @@ bool SearchContext::searchFile(int id, const std::string &filename, RegexList &f
                     std::string err = "WARNING: Couldn't write backup file (skipping replacement): ";
                     err += backupFilename;
                     err += "\n";
-                    poke(id, err.c_str(), HighlightList(), 0, false);
+                    poke(id, -1, err, false);
 
                     overwriteFile = false;
                 }
@@ -385,7 +423,7 @@ bool SearchContext::searchFile(int id, const std::string &filename, RegexList &f
                     std::string err = "WARNING: Couldn't write to file: ";
                     err += filename;
                     err += "\n";
-                    poke(id, err.c_str(), HighlightList(), 0, false);
+                    poke(id, -1, err, false);
                 }
             }
         }
@@ -437,6 +475,7 @@ void SearchContext::searchProc()
     paths = params_.paths;
     RegexList filespecRegexes;
     pcre *matchRegex = NULL;
+    pcre_extra matchExtra;
 
     directoriesSearched_ = 0;
     directoriesSkipped_ = 0;
@@ -468,6 +507,10 @@ void SearchContext::searchProc()
             goto cleanup;
         }
     }
+    memset(&matchExtra, 0, sizeof(matchExtra));
+    matchExtra.flags = PCRE_EXTRA_MATCH_LIMIT | PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+    matchExtra.match_limit = MATCH_LIMIT;
+    matchExtra.match_limit_recursion = MATCH_LIMIT_RECURSION;
 
     for(StringList::iterator it = params_.filespecs.begin(); it != params_.filespecs.end(); ++it)
     {
@@ -536,7 +579,7 @@ void SearchContext::searchProc()
             }
             else
             {
-                if(searchFile(id, filename, filespecRegexes, matchRegex))
+                if(searchFile(id, filename, filespecRegexes, matchRegex, &matchExtra))
                 {
                     filesSearched_++;
                 }
@@ -544,7 +587,7 @@ void SearchContext::searchProc()
                 {
                     filesSkipped_++;
                 }
-                poke(id, "", HighlightList(), 0, false);
+                poke(id, -1, std::string(), false);
             }
         }
 
@@ -579,7 +622,7 @@ cleanup:
             verb,
             filesSkipped_,
             sec);
-        poke(id, buffer, HighlightList(), 0, true);
+        poke(id, -1, buffer, true);
     }
     delete pokeData_;
     pokeData_ = NULL;
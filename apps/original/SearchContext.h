@@ -54,7 +54,8 @@ public:
     std::string match_;
 	HighlightList highlights_;
     int line_;
-    int offset_;
+    int offset_;     // where this entry's display text ends, set when the UI formats it
+    int trimLength_; // how much of filename_ SF_TRIM_FILENAMES leaves off, worked out once per file
 };
 
 typedef std::vector<SearchEntry> SearchList;
@@ -71,11 +72,22 @@ struct SearchParams
     int flags;
 };
 
+// One thing to show: an entry in the list (formatted by the UI thread, not the search thread) or
+// a plain message
+struct PokeItem
+{
+    PokeItem(int e, const std::string &m) : entry(e), message(m) {}
+
+    int entry; // -1 for a message
+    std::string message;
+};
+
+typedef std::vector<PokeItem> PokeItemList;
+
 struct PokeData // pika, pika!
 {
     std::string progress;
-	std::string text;
-	HighlightList highlights;
+    PokeItemList items;
 };
 
 class SearchContext
@@ -89,9 +101,10 @@ public:
     void append(int id, SearchEntry &entry);         // takes ownership
     void search(const SearchParams &params); // copies
     void stop();
-    void poke(int id, const std::string &str, HighlightList &highlights, int highlightOffset, bool finished);
+    void poke(int id, int entry, const std::string &message, bool finished);
 
-    std::string generateDisplay(SearchEntry &entry, int &textOffset);
+    // UI thread only: turns a poke's items into display text and highlights
+    void generateDisplay(PokeData &pokeData, std::string &text, HighlightList &highlights);
 
     void lock();
     SearchList &list();
@@ -106,7 +119,7 @@ public:
 	HWND getWindow() const { return window_; }
 
 protected:
-    bool searchFile(int id, const std::string &filename, RegexList &filespecRegexes, pcre *matchRegex);
+    bool searchFile(int id, const std::string &filename, RegexList &filespecRegexes, pcre *matchRegex, pcre_extra *matchExtra);
 
     int directoriesSearched_;
     int directoriesSkipped_;
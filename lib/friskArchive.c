@@ -0,0 +1,367 @@
+#include "friskArchive.h"
+
+#include "dynString.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define MAX_ENTRY_SIZE (0x7ffffffe)
+#define TAR_BLOCK_SIZE (512)
+
+static const char *archiveExtensions[] =
+{
+    ".zip", ".jar", ".war", ".ear", ".apk", ".nupkg",
+    ".tar", ".tgz", ".tar.gz", ".txz", ".tar.xz", ".tzst", ".tar.zst",
+    NULL
+};
+
+// ------------------------------------------------------------------------------------------------
+
+static unsigned int readU16(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    return u[0] | (u[1] << 8);
+}
+
+static unsigned int readU32(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    return u[0] | (u[1] << 8) | (u[2] << 16) | ((unsigned int)u[3] << 24);
+}
+
+static unsigned long long readU64(const char *p)
+{
+    return readU32(p) | ((unsigned long long)readU32(p + 4) << 32);
+}
+
+static int endsWith(const char *s, int len, const char *suffix)
+{
+    int suffixLen = (int)strlen(suffix);
+    int i;
+    if(len < suffixLen)
+        return 0;
+    for(i = 0; i < suffixLen; ++i)
+    {
+        if(tolower((unsigned char)s[len - suffixLen + i]) != suffix[i])
+            return 0;
+    }
+    return 1;
+}
+
+int friskArchiveNameMatches(const char * filename)
+{
+    int len = (int)strlen(filename);
+    int i;
+    for(i = 0; archiveExtensions[i]; ++i)
+    {
+        if(endsWith(filename, len, archiveExtensions[i]))
+            return 1;
+    }
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Zip
+
+// Finds the central directory through the end record (and the zip64 one, if the counts overflowed)
+static int openZip(friskArchive *archive)
+{
+    const char *data = archive->data;
+    int size = archive->size;
+    int eocd;
+    unsigned long long entries;
+    unsigned long long cdOffset;
+
+    for(eocd = size - 22; (eocd >= 0) && (eocd >= size - 22 - 0xffff); --eocd)
+    {
+        if(readU32(data + eocd) == 0x06054b50)
+            break;
+    }
+    if((eocd < 0) || (eocd < size - 22 - 0xffff))
+        return 0;
+
+    entries = readU16(data + eocd + 10);
+    cdOffset = readU32(data + eocd + 16);
+    if(((entries == 0xffff) || (cdOffset == 0xffffffff)) && (eocd >= 20) && (readU32(data + eocd - 20) == 0x07064b50))
+    {
+        unsigned long long zip64 = readU64(data + eocd - 20 + 8);
+        if((zip64 + 56 > (unsigned long long)size) || (readU32(data + zip64) != 0x06064b50))
+            return 0;
+        entries = readU64(data + zip64 + 32);
+        cdOffset = readU64(data + zip64 + 48);
+    }
+    if(cdOffset > (unsigned long long)size)
+        return 0;
+
+    archive->type = FA_ZIP;
+    archive->offset = (int)cdOffset;
+    archive->entriesLeft = (entries > 0x7fffffff) ? 0x7fffffff : (int)entries;
+    return 1;
+}
+
+static char *inflateEntry(const char *data, unsigned int compressedSize, unsigned int size)
+{
+    z_stream stream;
+    char *contents = (char *)malloc(size + 1);
+    int rc;
+
+    memset(&stream, 0, sizeof(stream));
+    if(inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+    {
+        free(contents);
+        return NULL;
+    }
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = compressedSize;
+    stream.next_out = (Bytef *)contents;
+    stream.avail_out = size;
+    rc = inflate(&stream, Z_FINISH);
+    if((rc != Z_STREAM_END) || (stream.total_out != size))
+    {
+        free(contents);
+        contents = NULL;
+    }
+    inflateEnd(&stream);
+    return contents;
+}
+
+static int nextZipEntry(friskArchive *archive, char **name, char **contents, int *size, unsigned long long maxSize, char **error)
+{
+    const char *data = archive->data;
+    while(archive->entriesLeft > 0)
+    {
+        const char *header = data + archive->offset;
+        unsigned int flags, method, compressedSize, uncompressedSize, nameLen, localOffset;
+        long long dataOffset;
+
+        archive->entriesLeft--;
+        if(((long long)archive->offset + 46 > archive->size) || (readU32(header) != 0x02014b50))
+            break;
+        flags = readU16(header + 8);
+        method = readU16(header + 10);
+        compressedSize = readU32(header + 20);
+        uncompressedSize = readU32(header + 24);
+        nameLen = readU16(header + 28);
+        localOffset = readU32(header + 42);
+        if((long long)archive->offset + 46 + nameLen > archive->size)
+            break;
+        dsCopyLen(name, header + 46, nameLen);
+        archive->offset += 46 + nameLen + readU16(header + 30) + readU16(header + 32);
+
+        if(!nameLen || (header[46 + nameLen - 1] == '/'))
+            continue; // directory
+
+        *contents = NULL;
+        *size = 0;
+        if(flags & 1)
+        {
+            dsCopy(error, "is encrypted");
+            return 1;
+        }
+        if((uncompressedSize > MAX_ENTRY_SIZE) || (maxSize && (uncompressedSize > maxSize)))
+        {
+            dsCopy(error, "is too big");
+            return 1;
+        }
+        if(((long long)localOffset + 30 > archive->size) || (readU32(data + localOffset) != 0x04034b50))
+        {
+            dsCopy(error, "has a corrupt local header");
+            return 1;
+        }
+        dataOffset = (long long)localOffset + 30 + readU16(data + localOffset + 26) + readU16(data + localOffset + 28);
+        if(dataOffset + compressedSize > archive->size)
+        {
+            dsCopy(error, "is truncated");
+            return 1;
+        }
+
+        if((method == 0) && (compressedSize == uncompressedSize))
+        {
+            *contents = (char *)malloc(uncompressedSize + 1);
+            memcpy(*contents, data + dataOffset, uncompressedSize);
+        }
+        else if(method == 8)
+        {
+            *contents = inflateEntry(data + dataOffset, compressedSize, uncompressedSize);
+            if(!*contents)
+                dsCopy(error, "has corrupt deflate data");
+        }
+        else
+        {
+            dsPrintf(error, "uses unsupported compression method %u", method);
+        }
+        if(*contents)
+        {
+            (*contents)[uncompressedSize] = 0;
+            *size = (int)uncompressedSize;
+        }
+        return 1;
+    }
+    archive->entriesLeft = 0;
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Tar
+
+static long long parseTarNumber(const char *field, int len)
+{
+    const unsigned char *u = (const unsigned char *)field;
+    long long value = 0;
+    int i;
+    if(u[0] & 0x80)
+    {
+        // GNU base-256 for sizes that don't fit in octal
+        for(i = 1; i < len; ++i)
+        {
+            if(value > (0x7fffffffffffffffLL >> 8))
+                return -1;
+            value = (value << 8) | u[i];
+        }
+        return value;
+    }
+    for(i = 0; (i < len) && (field[i] == ' '); ++i)
+    {
+    }
+    for(; (i < len) && (field[i] >= '0') && (field[i] <= '7'); ++i)
+    {
+        if(value > (0x7fffffffffffffffLL >> 3))
+            return -1;
+        value = (value << 3) | (field[i] - '0');
+    }
+    return value;
+}
+
+// Pulls "path" out of a pax extended header ("<len> key=value\n" records)
+static void parsePaxPath(const char *data, int len, char **path)
+{
+    int offset = 0;
+    while(offset < len)
+    {
+        const char *record = data + offset;
+        const char *key;
+        int recordLen = 0;
+        int i;
+        for(i = 0; (offset + i < len) && (record[i] >= '0') && (record[i] <= '9'); ++i)
+            recordLen = recordLen * 10 + (record[i] - '0');
+        if((recordLen <= i) || (offset + recordLen > len) || (record[i] != ' '))
+            return;
+        key = record + i + 1;
+        if(((record + recordLen) - key > 5) && !strncmp(key, "path=", 5))
+            dsCopyLen(path, key + 5, (int)((record + recordLen - 1) - (key + 5)));
+        offset += recordLen;
+    }
+}
+
+static int nextTarEntry(friskArchive *archive, char **name, char **contents, int *size, unsigned long long maxSize, char **error)
+{
+    const char *data = archive->data;
+    char *longName = NULL;
+
+    while((long long)archive->offset + TAR_BLOCK_SIZE <= archive->size)
+    {
+        const char *header = data + archive->offset;
+        long long entrySize = parseTarNumber(header + 124, 12);
+        long long dataOffset = (long long)archive->offset + TAR_BLOCK_SIZE;
+        char type = header[156];
+
+        if(!header[0])
+            break; // the zero blocks at the end
+
+        if((entrySize < 0) || (dataOffset + entrySize > archive->size))
+        {
+            dsCopyLen(name, header, (int)strnlen(header, 100));
+            dsCopy(error, "is truncated");
+            *contents = NULL;
+            *size = 0;
+            archive->offset = archive->size;
+            dsDestroy(&longName);
+            return 1;
+        }
+        archive->offset = (int)(dataOffset + ((entrySize + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE) * TAR_BLOCK_SIZE);
+        if(archive->offset < 0)
+            archive->offset = archive->size;
+
+        if(type == 'L')
+        {
+            // GNU long name for the entry that follows
+            dsCopyLen(&longName, data + dataOffset, (int)strnlen(data + dataOffset, (size_t)entrySize));
+            continue;
+        }
+        if(type == 'x')
+        {
+            parsePaxPath(data + dataOffset, (int)entrySize, &longName);
+            continue;
+        }
+        if((type != '0') && (type != '\0') && (type != '7'))
+        {
+            // Directories, links, devices, global pax headers...
+            dsDestroy(&longName);
+            continue;
+        }
+
+        if(longName)
+        {
+            dsCopy(name, longName);
+            dsDestroy(&longName);
+        }
+        else if(!memcmp(header + 257, "ustar", 5) && header[345])
+        {
+            dsCopyLen(name, header + 345, (int)strnlen(header + 345, 155));
+            dsConcat(name, "/");
+            dsConcatLen(name, header, (int)strnlen(header, 100));
+        }
+        else
+        {
+            dsCopyLen(name, header, (int)strnlen(header, 100));
+        }
+
+        *contents = NULL;
+        *size = 0;
+        if((entrySize > MAX_ENTRY_SIZE) || (maxSize && ((unsigned long long)entrySize > maxSize)))
+        {
+            dsCopy(error, "is too big");
+            return 1;
+        }
+        *contents = (char *)malloc((size_t)entrySize + 1);
+        memcpy(*contents, data + dataOffset, (size_t)entrySize);
+        (*contents)[entrySize] = 0;
+        *size = (int)entrySize;
+        return 1;
+    }
+    archive->offset = archive->size;
+    dsDestroy(&longName);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+friskArchive * friskArchiveOpen(const char * data, int size)
+{
+    friskArchive *archive = (friskArchive *)calloc(1, sizeof(friskArchive));
+    archive->data = data;
+    archive->size = size;
+    if(openZip(archive))
+        return archive;
+    if((size >= TAR_BLOCK_SIZE) && !memcmp(data + 257, "ustar", 5))
+    {
+        archive->type = FA_TAR;
+        return archive;
+    }
+    free(archive);
+    return NULL;
+}
+
+void friskArchiveClose(friskArchive * archive)
+{
+    free(archive);
+}
+
+int friskArchiveNext(friskArchive * archive, char ** name, char ** contents, int * size, unsigned long long maxSize, char ** error)
+{
+    if(archive->type == FA_ZIP)
+        return nextZipEntry(archive, name, contents, size, maxSize, error);
+    return nextTarEntry(archive, name, contents, size, maxSize, error);
+}
@@ -0,0 +1,41 @@
+#ifndef FRISKARCHIVE_H
+#define FRISKARCHIVE_H
+
+// ------------------------------------------------------------------------------------------------
+// Walks the files inside a zip (jar, war, ...) or tar archive that is already in memory, handing
+// each one back as its own buffer. Nothing is ever extracted to disk. Zip entries may be stored or
+// deflated; compressed tars (.tgz etc.) should be run through friskDecompress() first.
+
+typedef enum friskArchiveType
+{
+    FA_NONE = 0,
+    FA_ZIP,
+    FA_TAR,
+
+    FA_COUNT
+} friskArchiveType;
+
+typedef struct friskArchive
+{
+    friskArchiveType type;
+    const char * data;
+    int size;
+    int offset;       // zip: next central directory record, tar: next header
+    int entriesLeft;  // zip only
+} friskArchive;
+
+// Cheap check on the filename alone, so the walker knows which files are worth opening as archives
+// even when they don't match the filespecs themselves.
+int friskArchiveNameMatches(const char * filename);
+
+// Returns NULL if data isn't a zip or tar archive. data must outlive the archive.
+friskArchive * friskArchiveOpen(const char * data, int size);
+void friskArchiveClose(friskArchive * archive);
+
+// Moves to the next file in the archive and fills in its name (dynString) and contents (malloc'd,
+// NUL terminated). Returns 0 at the end. If the entry can't be read (unsupported compression,
+// bigger than maxSize bytes, corrupt...) contents is NULL and error says why, and the caller can
+// carry on to the next one.
+int friskArchiveNext(friskArchive * archive, char ** name, char ** contents, int * size, unsigned long long maxSize, char ** error);
+
+#endif
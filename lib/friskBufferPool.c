@@ -0,0 +1,162 @@
+#include "friskBufferPool.h"
+#include "friskThread.h"
+
+#include "dynArray.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ------------------------------------------------------------------------------------------------
+
+static int classSize(int cls)
+{
+    return 1 << (cls + FRISK_BUFFER_MIN_SHIFT);
+}
+
+// Smallest class that holds size, or -1 if it's too big for any
+static int classForGet(int size)
+{
+    int cls = 0;
+    while((cls < FRISK_BUFFER_CLASSES) && (classSize(cls) < size))
+        cls++;
+    return (cls < FRISK_BUFFER_CLASSES) ? cls : -1;
+}
+
+// The class Get() hands out buffers of exactly capacity bytes from, or -1 if there isn't one (so
+// the buffer can't have come from a pool)
+static int classForPut(int capacity)
+{
+    int cls = classForGet(capacity);
+    return ((cls >= 0) && (classSize(cls) == capacity)) ? cls : -1;
+}
+
+static void trim(friskBufferPool *pool)
+{
+    int cls;
+    for(cls = FRISK_BUFFER_CLASSES - 1; (cls >= 0) && (pool->cachedBytes > pool->highWater); --cls)
+    {
+        while(daSize(&pool->cached[cls]) && (pool->cachedBytes > pool->highWater))
+        {
+            free(daPop(&pool->cached[cls]));
+            pool->cachedBytes -= classSize(cls);
+        }
+    }
+    pool->highWater = pool->inUseBytes;
+    pool->getsSinceTrim = 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+friskBufferPool * friskBufferPoolCreate(int shared)
+{
+    friskBufferPool *pool = (friskBufferPool *)calloc(1, sizeof(friskBufferPool));
+    if(shared)
+        pool->lock = friskMutexCreate();
+    return pool;
+}
+
+void friskBufferPoolDestroy(friskBufferPool * pool)
+{
+    int cls;
+    if(!pool)
+        return;
+    for(cls = 0; cls < FRISK_BUFFER_CLASSES; ++cls)
+        daDestroy(&pool->cached[cls], free);
+    if(pool->lock)
+        friskMutexDestroy(pool->lock);
+    free(pool);
+}
+
+char * friskBufferPoolGet(friskBufferPool * pool, int size, int * capacity)
+{
+    int cls = classForGet(size);
+    char *data = NULL;
+
+    if(!pool || (cls < 0))
+    {
+        if(capacity)
+            *capacity = size;
+        return (char *)malloc(size);
+    }
+
+    if(pool->lock)
+        friskMutexLock(pool->lock);
+    pool->gets++;
+    if(daSize(&pool->cached[cls]))
+    {
+        data = (char *)daPop(&pool->cached[cls]);
+        pool->cachedBytes -= classSize(cls);
+        pool->reuses++;
+    }
+    pool->inUseBytes += classSize(cls);
+    if(pool->inUseBytes > pool->highWater)
+        pool->highWater = pool->inUseBytes;
+    if(++pool->getsSinceTrim >= FRISK_BUFFER_TRIM_INTERVAL)
+        trim(pool);
+    if(pool->lock)
+        friskMutexUnlock(pool->lock);
+
+    if(!data)
+        data = (char *)malloc(classSize(cls));
+    if(capacity)
+        *capacity = classSize(cls);
+    return data;
+}
+
+void friskBufferPoolPut(friskBufferPool * pool, char * data, int capacity)
+{
+    int cls = classForPut(capacity);
+    if(!data)
+        return;
+    if(!pool || (cls < 0))
+    {
+        free(data);
+        return;
+    }
+
+    if(pool->lock)
+        friskMutexLock(pool->lock);
+    pool->inUseBytes -= classSize(cls);
+    daPush(&pool->cached[cls], data);
+    pool->cachedBytes += classSize(cls);
+    if(pool->lock)
+        friskMutexUnlock(pool->lock);
+}
+
+void friskBufferPoolForget(friskBufferPool * pool, int capacity)
+{
+    int cls = classForPut(capacity);
+    if(!pool || (cls < 0))
+        return;
+
+    if(pool->lock)
+        friskMutexLock(pool->lock);
+    pool->inUseBytes -= classSize(cls);
+    if(pool->lock)
+        friskMutexUnlock(pool->lock);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void friskPooledTextAppend(friskBufferPool * pool, friskPooledText * text, const char * append, int length)
+{
+    if(text->length + length + 1 > text->capacity)
+    {
+        int capacity;
+        char *data = friskBufferPoolGet(pool, text->length + length + 1, &capacity);
+        if(text->data)
+            memcpy(data, text->data, text->length);
+        friskBufferPoolPut(pool, text->data, text->capacity);
+        text->data = data;
+        text->capacity = capacity;
+    }
+    memcpy(text->data + text->length, append, length);
+    text->length += length;
+    text->data[text->length] = 0;
+}
+
+void friskPooledTextRelease(friskBufferPool * pool, friskPooledText * text)
+{
+    friskBufferPoolPut(pool, text->data, text->capacity);
+    memset(text, 0, sizeof(friskPooledText));
+}
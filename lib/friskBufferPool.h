@@ -0,0 +1,63 @@
+#ifndef FRISKBUFFERPOOL_H
+#define FRISKBUFFERPOOL_H
+
+// ------------------------------------------------------------------------------------------------
+// Reusable buffers for the per-file work of a search (file contents, the line scratch copy,
+// replacement output), so once a search has warmed up it isn't going to the heap for every file.
+// Buffers come in power-of-two size classes, and are plain malloc'd blocks, so one that ends up
+// owned by something else can simply be free()d there, once the pool has been told to Forget() it.
+// Only buffers the pool handed out are taken back; anything over the biggest class is just
+// malloc'd and freed.
+//
+// Each searching thread has its own pool. Only a pool created shared locks, for buffers that are
+// filled on one thread and finished with on another.
+//
+// Free buffers are trimmed to a high-water mark: every FRISK_BUFFER_TRIM_INTERVAL Get()s, whatever
+// is cached beyond the most that was in use at once since the last trim is freed, biggest first,
+// so one huge file doesn't keep its buffer alive for the rest of the search.
+
+#define FRISK_BUFFER_MIN_SHIFT (12) // 4KB is the smallest class
+#define FRISK_BUFFER_CLASSES (16)   // ... and 128MB the biggest
+#define FRISK_BUFFER_TRIM_INTERVAL (256)
+
+typedef struct friskBufferPool
+{
+    char ** cached[FRISK_BUFFER_CLASSES]; // dynArray of free buffers per class
+    long long cachedBytes;
+    long long inUseBytes;   // handed out and not put back yet
+    long long highWater;    // the most inUseBytes has been since the last trim
+    int getsSinceTrim;
+    int gets;
+    int reuses;             // gets that didn't need the heap
+    struct friskMutex * lock; // shared pools only
+} friskBufferPool;
+
+friskBufferPool * friskBufferPoolCreate(int shared);
+void friskBufferPoolDestroy(friskBufferPool * pool);
+
+// Returns a buffer of at least size bytes, and its actual size in *capacity (can be NULL). A NULL
+// pool just mallocs.
+char * friskBufferPoolGet(friskBufferPool * pool, int size, int * capacity);
+
+// Takes back data (can be NULL) along with the capacity Get() gave for it. A buffer that didn't
+// come from the pool (pass a capacity of 0) is just freed, as is everything with a NULL pool.
+void friskBufferPoolPut(friskBufferPool * pool, char * data, int capacity);
+
+// A buffer from Get() (capacity as given) now belongs to something that will free() it, so it no
+// longer counts as in use.
+void friskBufferPoolForget(friskBufferPool * pool, int capacity);
+
+// ------------------------------------------------------------------------------------------------
+
+// Growable NUL terminated text with its storage from a pool. Start it zeroed.
+typedef struct friskPooledText
+{
+    char * data;
+    int length;
+    int capacity;
+} friskPooledText;
+
+void friskPooledTextAppend(friskBufferPool * pool, friskPooledText * text, const char * append, int length);
+void friskPooledTextRelease(friskBufferPool * pool, friskPooledText * text);
+
+#endif
@@ -1,8 +1,11 @@
 #include "friskContext.h"
+#include "friskRegexCache.h"
 
 #include "dynArray.h"
 #include "dynString.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 friskSavedSearch * friskSavedSearchCreate()
 {
@@ -88,6 +91,31 @@ void friskHighlightDestroy(friskHighlight *highlight)
 
 // ------------------------------------------------------------------------------------------------
 
+friskBuffer * friskBufferCreate(char * data, int size)
+{
+    friskBuffer *buffer = (friskBuffer *)calloc(1, sizeof(friskBuffer));
+    buffer->data = data;
+    buffer->size = size;
+    buffer->refs = 1;
+    return buffer;
+}
+
+friskBuffer * friskBufferRetain(friskBuffer *buffer)
+{
+    buffer->refs++;
+    return buffer;
+}
+
+void friskBufferRelease(friskBuffer *buffer)
+{
+    if(--buffer->refs > 0)
+        return;
+    free(buffer->data);
+    free(buffer);
+}
+
+// ------------------------------------------------------------------------------------------------
+
 friskEntry * friskEntryCreate()
 {
     friskEntry *entry = (friskEntry *)calloc(1, sizeof(friskEntry));
@@ -99,6 +127,10 @@ void friskEntryDestroy(friskEntry *entry)
     dsDestroy(&entry->filename);
     dsDestroy(&entry->match);
     daDestroy(&entry->highlights, friskHighlightDestroy);
+    daDestroy(&entry->before, NULL);
+    daDestroy(&entry->after, NULL);
+    if(entry->buffer)
+        friskBufferRelease(entry->buffer);
     free(entry);
 }
 
@@ -114,12 +146,78 @@ void friskParamsDestroy(friskParams *params)
 {
     daDestroyStrings(&params->paths);
     daDestroyStrings(&params->filespecs);
+    daDestroyStrings(&params->excludeFilespecs);
+    daDestroyStrings(&params->excludeDirectories);
     dsDestroy(&params->match);
+    daDestroyStrings(&params->matches);
+    dsDestroy(&params->matchFile);
     dsDestroy(&params->replace);
     dsDestroy(&params->backupExtension);
     free(params);
 }
 
+int friskParamsPatterns(friskParams *params, char *** patterns)
+{
+    int i;
+    if(params->match && params->match[0])
+        daPush(patterns, dsDup(params->match));
+    for(i = 0; i < daSize(&params->matches); ++i)
+        daPush(patterns, dsDup(params->matches[i]));
+    if(params->matchFile && params->matchFile[0])
+    {
+        char *contents = NULL;
+        char *line;
+        int size;
+        if(!friskReadEntireFile(params->matchFile, &contents, &size, 0, 0))
+        {
+            // That won't hand back an empty file, which is fine here: it just adds no patterns
+            FILE *f = fopen(params->matchFile, "rb");
+            int empty = f && (fgetc(f) == EOF) && !ferror(f);
+            if(f)
+                fclose(f);
+            if(!empty)
+                return 0;
+        }
+
+        line = contents;
+        while(line && *line)
+        {
+            char *end = strchr(line, '\n');
+            char *next = NULL;
+            if(end)
+                next = end + 1;
+            else
+                end = line + strlen(line);
+            if((end > line) && (end[-1] == '\r'))
+                end--;
+            if(end > line)
+            {
+                char *pattern = NULL;
+                dsCopyLen(&pattern, line, (int)(end - line));
+                daPush(patterns, pattern);
+            }
+            line = next;
+        }
+        free(contents);
+    }
+    return 1;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+friskSkip * friskSkipCreate()
+{
+    friskSkip *skip = (friskSkip *)calloc(1, sizeof(friskSkip));
+    return skip;
+}
+
+void friskSkipDestroy(friskSkip *skip)
+{
+    dsDestroy(&skip->filename);
+    dsDestroy(&skip->reason);
+    free(skip);
+}
+
 // ------------------------------------------------------------------------------------------------
 
 friskContext * friskContextCreate()
@@ -127,6 +225,7 @@ friskContext * friskContextCreate()
     friskContext *context = (friskContext *)calloc(1, sizeof(friskContext));
     context->params = friskParamsCreate();
     context->config = friskConfigCreate();
+    context->regexCache = friskRegexCacheCreate(FRISK_REGEX_CACHE_SIZE);
     return context;
 }
 
@@ -135,5 +234,9 @@ void friskContextDestroy(friskContext *context)
     daDestroy(&context->list, friskEntryDestroy);
     friskParamsDestroy(context->params);
     friskConfigDestroy(context->config);
+    dsDestroy(&context->error);
+    daDestroyStrings(&context->warnings);
+    daDestroy(&context->skipped, friskSkipDestroy);
+    friskRegexCacheRelease(context->regexCache);
     free(context);
 }
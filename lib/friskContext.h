@@ -16,10 +16,30 @@ typedef enum friskSearchFlag
     FSF_REPLACE                 = (1 << 5),
     FSF_BACKUP                  = (1 << 6),
     FSF_TRIM_FILENAMES          = (1 << 7),
+    FSF_COUNT_HITS              = (1 << 8), // one entry per file with a hit count, no lines
+    FSF_FILES_WITH_HITS         = (1 << 9), // one entry per file, stop looking at its first hit
+    FSF_MULTILINE               = (1 << 10), // match across lines (regexes get PCRE_MULTILINE | PCRE_DOTALL)
+    FSF_UTF8                    = (1 << 11), // PCRE_UTF8 with Unicode case folding; files that aren't valid UTF-8 are skipped
+    FSF_DECOMPRESS              = (1 << 12), // search inside gzip/zstd/xz files (see friskDecompress.h)
+    FSF_ARCHIVES                = (1 << 13), // walk zip/tar files like directories (see friskArchive.h)
+    FSF_IGNORE_FILES            = (1 << 14), // honor .gitignore/.ignore/.friskignore (see friskIgnore.h)
+    FSF_SORTED                  = (1 << 15), // walk each directory in name order, so results come out ordered by path, then line
 
     FSF_COUNT
 } friskSearchFlag;
 
+// How files are read (params->ioPolicy). These are hints for the Linux page cache; elsewhere only
+// FIO_INODE_ORDER does anything, and only where the walk sees inode numbers.
+typedef enum friskIoFlag
+{
+    FIO_INODE_ORDER = (1 << 0), // search each directory's files in inode order (roughly disk order) unless FSF_SORTED
+    FIO_READAHEAD   = (1 << 1), // tell the kernel each file will be read straight through, as it's opened
+    FIO_DONT_CACHE  = (1 << 2)  // drop files of FRISK_DONT_CACHE_SIZE or more from the page cache once read
+} friskIoFlag;
+
+// Files this big are huge enough for FIO_DONT_CACHE to leave out of the page cache
+#define FRISK_DONT_CACHE_SIZE (32 * 1024 * 1024)
+
 // ------------------------------------------------------------------------------------------------
 
 typedef struct friskSavedSearch
@@ -78,6 +98,7 @@ typedef struct friskHighlight
 {
     int offset;
     int count;
+    int pattern; // index of the pattern that produced this hit (see friskParamsPatterns)
 } friskHighlight;
 
 friskHighlight * friskHighlightCreate();
@@ -85,13 +106,37 @@ void friskHighlightDestroy(friskHighlight *highlight);
 
 // ------------------------------------------------------------------------------------------------
 
+// A loaded file, shared by every entry that points into it. The search splits it into lines in
+// place, so any line in it can be handed out as a plain NUL-terminated string.
+typedef struct friskBuffer
+{
+    char * data;
+    int size;
+    int refs;
+} friskBuffer;
+
+friskBuffer * friskBufferCreate(char * data, int size); // takes ownership of data (malloc'd)
+friskBuffer * friskBufferRetain(friskBuffer *buffer);
+void friskBufferRelease(friskBuffer *buffer);
+
+// ------------------------------------------------------------------------------------------------
+
 typedef struct friskEntry
 {
     char * filename;
     char * match;
     friskHighlight ** highlights;
     int line;
-    int offset;
+    int endLine; // last line the hit touches, only differs from line with FSF_MULTILINE
+    int offset;  // byte offset of the start of line in the file (after any decompression/decoding)
+    int hits; // only set by FSF_COUNT_HITS / FSF_FILES_WITH_HITS, which leave match empty
+
+    // Context lines (params->contextBefore/After) are slices of buffer, not copies. before ends at
+    // line - 1 and after starts at line + 1. Overlapping windows are merged, so a line shows up
+    // at most once across a file's entries, and never as context if it is a hit itself.
+    friskBuffer * buffer;
+    char ** before; // dynArray
+    char ** after;  // dynArray
 } friskEntry;
 
 friskEntry * friskEntryCreate();
@@ -103,16 +148,56 @@ typedef struct friskParams
 {
     char ** paths;
     char ** filespecs;
+    char ** excludeFilespecs;   // files to leave out even if they match filespecs
+    char ** excludeDirectories; // directories to prune without opening them
     char * match;
+    char ** matches;   // additional patterns, searched in the same pass as match
+    char * matchFile;  // file with one more pattern per line
     char * replace;
     char * backupExtension;
-    unsigned long long maxFileSize;
+    unsigned long long maxFileSize;   // KB, 0 for no limit
+    unsigned long long minFileSize;   // KB, 0 for no limit
+    long long modifiedAfter;          // seconds since the epoch, 0 for no limit
+    long long modifiedBefore;         // (sizes and times are checked before a file is ever opened)
+    int maxDepth;                     // 1 searches just the files directly in paths, 0 for no limit
+    int matchLimit;          // pcre match_limit, 0 for PCRE's default
+    int matchLimitRecursion; // pcre match_limit_recursion, 0 for PCRE's default
+    int fileTimeLimit;       // milliseconds to spend on one file before giving up on it, 0 for no limit
+                             // (checked between lines and between hits: a single pcre_exec on one
+                             // huge line, or on the whole file with FSF_MULTILINE, is only bounded
+                             // by matchLimit and matchLimitRecursion)
+    int maxHitsPerFile;      // 0 for no limit (all of these set context->truncated when they kick in)
+    int maxHits;
+    int maxFilesWithHits;
+    int contextBefore;       // lines of context to keep around each hit (ignored when replacing
+    int contextAfter;        // and with FSF_MULTILINE, which adds a warning)
+    int threads;             // threads searching files (the walk is always one), 0 for one per core
+    int threadPolicy;        // friskThreadPolicy: how those threads are placed (see friskPool.h)
+    int readDepth;           // files read ahead of those threads (see friskReader.h), 0 for the default, -1 for none
+    int ioPolicy;            // friskIoFlag
     int flags;
 } friskParams;
 
 friskParams * friskParamsCreate();
 void friskParamsDestroy(friskParams *params);
 
+// Gathers match, matches and the lines of matchFile (in that order) into one list of patterns.
+// Highlight pattern indices refer to this list. Returns 0 if matchFile couldn't be read (an
+// empty one is fine).
+int friskParamsPatterns(friskParams *params, char *** patterns);
+
+// ------------------------------------------------------------------------------------------------
+
+// A file that was given up on partway through, and why
+typedef struct friskSkip
+{
+    char * filename;
+    char * reason;
+} friskSkip;
+
+friskSkip * friskSkipCreate();
+void friskSkipDestroy(friskSkip *skip);
+
 // ------------------------------------------------------------------------------------------------
 
 #ifdef NOT_YET
@@ -124,9 +209,17 @@ typedef struct friskPokeData
 } friskPokeData;
 #endif
 
+struct friskBufferPool;
+struct friskContext;
+struct friskRegexCache;
+
+// Called as soon as a file's results are in, with the index of the first entry it added to list
+// (everything from there to the end of list is that file's), so a frontend can show them while
+// the search carries on.
+typedef void (*friskResultsFunc)(struct friskContext *context, int first, void *userData);
+
 typedef struct friskContext
 {
-#ifdef NOT_YET
     int directoriesSearched;
     int directoriesSkipped;
     int filesSearched;
@@ -134,25 +227,48 @@ typedef struct friskContext
     int filesWithHits;
     int linesWithHits;
     int hits;
+    int truncated;      // a hit limit in params cut the results short
+
+    volatile int stop;  // set to cancel the search; everything checks it cooperatively
 
+#ifdef NOT_YET
     //HANDLE mutex;
     //HANDLE thread;
 
-    int stop;
     int searchID;
     int offset;
     unsigned int lastPoke;
     friskPokeData * pokeData;
 #endif
 
+    friskResultsFunc onResults; // optional
+    void * userData;
+
+    struct friskRegexCache * regexCache; // compiled regexes kept between searches (see friskRegexCache.h)
+
     friskEntry **list;
     friskParams * params;
     friskConfig * config;
+    char * error;
+    char ** warnings;
+    friskSkip ** skipped;
 } friskContext;
 
 friskContext * friskContextCreate();
 void friskContextDestroy(friskContext *context);
 
+// Runs the search described by context->params, appending hits to context->list. Returns 0 and
+// fills in context->error if the search couldn't be started.
+int friskContextSearch(friskContext *context);
+
+// ------------------------------------------------------------------------------------------------
+
+unsigned long long friskGetTickCount();
+int friskReadEntireFile(const char *filename, char **contents, int *size, unsigned long long maxSizeKb, int ioPolicy);
+// The same, with contents from pool (NULL to malloc) and its room in *capacity
+int friskReadPooledFile(struct friskBufferPool *pool, const char *filename, char **contents, int *size, int *capacity, unsigned long long maxSizeKb, int ioPolicy);
+int friskWriteEntireFile(const char *filename, const char *contents, int size);
+
 // ------------------------------------------------------------------------------------------------
 
 #endif
@@ -0,0 +1,297 @@
+#include "friskDecompress.h"
+
+#include "dynString.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#ifdef FRISK_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef FRISK_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#define CHUNK_SIZE (256 * 1024)
+#define MAX_OUTPUT_SIZE (0x7ffffffe)
+
+// ------------------------------------------------------------------------------------------------
+// Output buffer shared by the decoders
+
+typedef struct friskInflated
+{
+    char *data;
+    int size;
+    int capacity;
+    unsigned long long limit;
+} friskInflated;
+
+// Makes room for at least one more chunk and returns where it goes, or NULL once the output would
+// pass the limit.
+static char *reserveChunk(friskInflated *out, int *available)
+{
+    if(out->capacity - out->size < CHUNK_SIZE)
+    {
+        unsigned long long capacity = (unsigned long long)out->capacity * 2 + CHUNK_SIZE;
+        if((unsigned long long)out->size >= out->limit)
+            return NULL;
+        if(capacity > out->limit + 1)
+            capacity = out->limit + 1;
+        out->data = (char *)realloc(out->data, (size_t)capacity);
+        out->capacity = (int)capacity;
+    }
+    *available = out->capacity - out->size - 1; // room for the NUL
+    return out->data + out->size;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Decoders
+
+static int decodeGzip(const char *data, int size, friskInflated *out, char **error)
+{
+    z_stream stream;
+    int members = 0;
+    int done = 0;
+
+    memset(&stream, 0, sizeof(stream));
+    if(inflateInit2(&stream, 15 + 32) != Z_OK) // +32: gzip or zlib header, whichever is there
+    {
+        dsCopy(error, "couldn't start the gzip decoder");
+        return 0;
+    }
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = size;
+
+    for(;;)
+    {
+        int rc;
+        int available;
+        char *chunk = reserveChunk(out, &available);
+        if(!chunk)
+        {
+            dsCopy(error, "too big once decompressed");
+            break;
+        }
+        stream.next_out = (Bytef *)chunk;
+        stream.avail_out = available;
+        rc = inflate(&stream, Z_NO_FLUSH);
+        out->size += available - stream.avail_out;
+
+        // Rotated logs are often several gzip members back to back
+        if((rc == Z_STREAM_END) && stream.avail_in)
+        {
+            members++;
+            inflateReset(&stream);
+            continue;
+        }
+        if(rc == Z_STREAM_END)
+        {
+            done = 1;
+            break;
+        }
+        if((rc != Z_OK) && (rc != Z_BUF_ERROR))
+        {
+            // Like gzip itself, ignore padding after a complete member
+            if(members && (out->size > 0))
+            {
+                done = 1;
+                break;
+            }
+            dsPrintf(error, "corrupt gzip data (%s)", stream.msg ? stream.msg : "unknown error");
+            break;
+        }
+        if(!stream.avail_in && stream.avail_out)
+        {
+            dsCopy(error, "truncated gzip data");
+            break;
+        }
+    }
+    inflateEnd(&stream);
+    return done;
+}
+
+#ifdef FRISK_HAVE_ZSTD
+static int decodeZstd(const char *data, int size, friskInflated *out, char **error)
+{
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    ZSTD_inBuffer input;
+    int done = 0;
+
+    ZSTD_initDStream(stream);
+    input.src = data;
+    input.size = size;
+    input.pos = 0;
+
+    for(;;)
+    {
+        ZSTD_outBuffer output;
+        size_t rc;
+        int available;
+        char *chunk = reserveChunk(out, &available);
+        if(!chunk)
+        {
+            dsCopy(error, "too big once decompressed");
+            break;
+        }
+        output.dst = chunk;
+        output.size = available;
+        output.pos = 0;
+        rc = ZSTD_decompressStream(stream, &output, &input);
+        out->size += (int)output.pos;
+        if(ZSTD_isError(rc))
+        {
+            dsPrintf(error, "corrupt zstd data (%s)", ZSTD_getErrorName(rc));
+            break;
+        }
+        if(input.pos == input.size)
+        {
+            // 0 means the last frame is complete; anything else with room left over is a cut off file
+            if(!rc)
+            {
+                done = 1;
+                break;
+            }
+            if(output.pos < output.size)
+            {
+                dsCopy(error, "truncated zstd data");
+                break;
+            }
+        }
+    }
+    ZSTD_freeDStream(stream);
+    return done;
+}
+#endif
+
+#ifdef FRISK_HAVE_LZMA
+static int decodeXz(const char *data, int size, friskInflated *out, char **error)
+{
+    lzma_stream stream = LZMA_STREAM_INIT;
+    int done = 0;
+
+    if(lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+    {
+        dsCopy(error, "couldn't start the xz decoder");
+        return 0;
+    }
+    stream.next_in = (const uint8_t *)data;
+    stream.avail_in = size;
+
+    for(;;)
+    {
+        lzma_ret rc;
+        int available;
+        char *chunk = reserveChunk(out, &available);
+        if(!chunk)
+        {
+            dsCopy(error, "too big once decompressed");
+            break;
+        }
+        stream.next_out = (uint8_t *)chunk;
+        stream.avail_out = available;
+        rc = lzma_code(&stream, stream.avail_in ? LZMA_RUN : LZMA_FINISH);
+        out->size += available - (int)stream.avail_out;
+        if(rc == LZMA_STREAM_END)
+        {
+            done = 1;
+            break;
+        }
+        if(rc != LZMA_OK)
+        {
+            dsPrintf(error, "corrupt xz data (error %d)", (int)rc);
+            break;
+        }
+    }
+    lzma_end(&stream);
+    return done;
+}
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// Decoder table; a new codec is a magic number and a decode function
+
+typedef int (*friskDecodeFunc)(const char *data, int size, friskInflated *out, char **error);
+
+typedef struct friskDecoder
+{
+    friskCompression compression;
+    const char *name;
+    const char *magic;
+    int magicSize;
+    friskDecodeFunc decode; // NULL when the build didn't have the library
+} friskDecoder;
+
+static friskDecoder decoders[] =
+{
+    { FC_GZIP, "gzip", "\x1f\x8b", 2, decodeGzip },
+#ifdef FRISK_HAVE_ZSTD
+    { FC_ZSTD, "zstd", "\x28\xb5\x2f\xfd", 4, decodeZstd },
+#else
+    { FC_ZSTD, "zstd", "\x28\xb5\x2f\xfd", 4, NULL },
+#endif
+#ifdef FRISK_HAVE_LZMA
+    { FC_XZ, "xz", "\xfd" "7zXZ\0", 6, decodeXz },
+#else
+    { FC_XZ, "xz", "\xfd" "7zXZ\0", 6, NULL },
+#endif
+};
+
+static const friskDecoder *findDecoder(friskCompression compression)
+{
+    int i;
+    for(i = 0; i < (int)(sizeof(decoders) / sizeof(decoders[0])); ++i)
+    {
+        if(decoders[i].compression == compression)
+            return &decoders[i];
+    }
+    return NULL;
+}
+
+friskCompression friskDetectCompression(const char * data, int size)
+{
+    int i;
+    for(i = 0; i < (int)(sizeof(decoders) / sizeof(decoders[0])); ++i)
+    {
+        if((size >= decoders[i].magicSize) && !memcmp(data, decoders[i].magic, decoders[i].magicSize))
+            return decoders[i].compression;
+    }
+    return FC_NONE;
+}
+
+const char * friskCompressionName(friskCompression compression)
+{
+    const friskDecoder *decoder = findDecoder(compression);
+    return decoder ? decoder->name : "none";
+}
+
+int friskDecompress(char ** data, int * size, friskCompression compression, unsigned long long maxSize, char ** error)
+{
+    const friskDecoder *decoder = findDecoder(compression);
+    friskInflated out;
+
+    if(!decoder)
+        return 1;
+    if(!decoder->decode)
+    {
+        dsPrintf(error, "is %s compressed, and this build has no %s support", decoder->name, decoder->name);
+        return 0;
+    }
+
+    memset(&out, 0, sizeof(out));
+    out.limit = (maxSize && (maxSize < MAX_OUTPUT_SIZE)) ? maxSize : MAX_OUTPUT_SIZE;
+    if(!decoder->decode(*data, *size, &out, error))
+    {
+        free(out.data);
+        return 0;
+    }
+
+    if(!out.data)
+        out.data = (char *)malloc(1);
+    out.data[out.size] = 0;
+    free(*data);
+    *data = out.data;
+    *size = out.size;
+    return 1;
+}
@@ -0,0 +1,27 @@
+#ifndef FRISKDECOMPRESS_H
+#define FRISKDECOMPRESS_H
+
+// ------------------------------------------------------------------------------------------------
+// Compressed files are recognised by their magic bytes and inflated into a plain buffer before the
+// search sees them, chunk by chunk straight out of the codec. gzip is always available; zstd and
+// xz are compiled in when the build finds them (FRISK_HAVE_ZSTD / FRISK_HAVE_LZMA).
+
+typedef enum friskCompression
+{
+    FC_NONE = 0,
+    FC_GZIP,
+    FC_ZSTD,
+    FC_XZ,
+
+    FC_COUNT
+} friskCompression;
+
+friskCompression friskDetectCompression(const char * data, int size);
+const char * friskCompressionName(friskCompression compression);
+
+// Replaces *data (malloc'd) with its decompressed contents, NUL terminated. maxSize caps the
+// decompressed size in bytes (0 for no limit beyond what fits in an int). On failure, *data is left
+// alone, error says why and 0 is returned.
+int friskDecompress(char ** data, int * size, friskCompression compression, unsigned long long maxSize, char ** error);
+
+#endif
@@ -0,0 +1,1005 @@
+#include "friskDfa.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_INSTRUCTIONS (4096)
+#define STATE_HASH_SIZE (1024)
+
+// ------------------------------------------------------------------------------------------------
+// Parse tree
+
+enum
+{
+    NODE_EMPTY = 0,
+    NODE_SET,
+    NODE_CONCAT,
+    NODE_ALT,
+    NODE_REPEAT,
+    NODE_BOL,
+    NODE_EOL
+};
+
+typedef struct friskDfaNode
+{
+    int type;
+    int set;
+    int min;
+    int max; // -1 for unbounded
+    int lazy;
+    struct friskDfaNode *left;
+    struct friskDfaNode *right;
+} friskDfaNode;
+
+typedef struct friskDfaParser
+{
+    const char *p;
+    int caseless;
+    int unsupported;
+    friskDfa *dfa;
+} friskDfaParser;
+
+// ------------------------------------------------------------------------------------------------
+// Program and state cache
+
+enum
+{
+    OP_BYTES = 1, // consume one byte in sets[x]
+    OP_SPLIT,     // try x, then y
+    OP_JMP,
+    OP_MATCH,
+    OP_BOL,
+    OP_EOL
+};
+
+typedef struct friskDfaInst
+{
+    int op;
+    int x;
+    int y;
+} friskDfaInst;
+
+typedef struct friskDfaState
+{
+    int *pcs;      // threads, in priority order
+    int count;
+    int match;
+    unsigned int hash;
+    int chain;
+    int *next;     // per byte class; -1 until computed
+} friskDfaState;
+
+typedef struct friskDfaMachine
+{
+    friskDfaInst *insts;
+    int instCount;
+    int instCapacity;
+    int startOp;       // assertion that holds at the very start of a scan (if at all)
+    int pendingOp;     // assertion that can only be resolved once the scan runs out of text
+    int leftmostFirst; // drop lower priority threads as soon as one matches
+
+    friskDfaState *states;
+    int stateCount;
+    int stateCapacity;
+    int buckets[STATE_HASH_SIZE];
+    int startStates[2];
+
+    int *stack;
+    int *seeds;
+    int *list;
+    unsigned char *visited;
+} friskDfaMachine;
+
+// ------------------------------------------------------------------------------------------------
+// Byte sets
+
+static void setAdd(unsigned char *set, int c)
+{
+    set[c >> 3] |= (unsigned char)(1 << (c & 7));
+}
+
+static int setHas(const unsigned char *set, int c)
+{
+    return (set[c >> 3] >> (c & 7)) & 1;
+}
+
+static void setAddRange(unsigned char *set, int lo, int hi)
+{
+    int c;
+    for(c = lo; c <= hi; ++c)
+        setAdd(set, c);
+}
+
+static void setFold(unsigned char *set)
+{
+    int c;
+    for(c = 'a'; c <= 'z'; ++c)
+    {
+        if(setHas(set, c) || setHas(set, toupper(c)))
+        {
+            setAdd(set, c);
+            setAdd(set, toupper(c));
+        }
+    }
+}
+
+static void setInvert(unsigned char *set)
+{
+    int i;
+    for(i = 0; i < 32; ++i)
+        set[i] = (unsigned char)~set[i];
+}
+
+static int newSet(friskDfa *dfa)
+{
+    dfa->sets = (unsigned char (*)[32])realloc(dfa->sets, sizeof(*dfa->sets) * (dfa->setCount + 1));
+    memset(dfa->sets[dfa->setCount], 0, sizeof(*dfa->sets));
+    return dfa->setCount++;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Parser
+
+static friskDfaNode *newNode(int type, friskDfaNode *left, friskDfaNode *right)
+{
+    friskDfaNode *node = (friskDfaNode *)calloc(1, sizeof(friskDfaNode));
+    node->type = type;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+static void destroyNode(friskDfaNode *node)
+{
+    if(!node)
+        return;
+    destroyNode(node->left);
+    destroyNode(node->right);
+    free(node);
+}
+
+enum
+{
+    ESCAPE_UNSUPPORTED = 0,
+    ESCAPE_LITERAL,
+    ESCAPE_CLASS
+};
+
+// Matches PCRE's default (non-UTF, "C" locale) tables
+static int parseEscape(friskDfaParser *parser, int *literal, unsigned char *set)
+{
+    char c = *parser->p++;
+    int negate = 0;
+    switch(c)
+    {
+        case 't': *literal = '\t'; return ESCAPE_LITERAL;
+        case 'n': *literal = '\n'; return ESCAPE_LITERAL;
+        case 'r': *literal = '\r'; return ESCAPE_LITERAL;
+        case 'f': *literal = '\f'; return ESCAPE_LITERAL;
+        case 'e': *literal = 27;   return ESCAPE_LITERAL;
+        case 'a': *literal = 7;    return ESCAPE_LITERAL;
+
+        case 'D': negate = 1; // fallthrough
+        case 'd':
+            setAddRange(set, '0', '9');
+            break;
+        case 'W': negate = 1; // fallthrough
+        case 'w':
+            setAddRange(set, 'a', 'z');
+            setAddRange(set, 'A', 'Z');
+            setAddRange(set, '0', '9');
+            setAdd(set, '_');
+            break;
+        case 'S': negate = 1; // fallthrough
+        case 's':
+            setAdd(set, ' ');
+            setAdd(set, '\t');
+            setAdd(set, '\n');
+            setAdd(set, '\f');
+            setAdd(set, '\r');
+            break;
+
+        default:
+            if(!c || isalnum((unsigned char)c))
+                return ESCAPE_UNSUPPORTED; // backreferences, \b, \x, \p, \Q, ...
+            *literal = (unsigned char)c;
+            return ESCAPE_LITERAL;
+    }
+    if(negate)
+        setInvert(set);
+    return ESCAPE_CLASS;
+}
+
+static friskDfaNode *parseClass(friskDfaParser *parser)
+{
+    int set = newSet(parser->dfa);
+    int negate = 0;
+    int first = 1;
+    friskDfaNode *node;
+
+    if(*parser->p == '^')
+    {
+        negate = 1;
+        parser->p++;
+    }
+
+    for(;;)
+    {
+        int lo;
+        int hi;
+        char c = *parser->p;
+        if(!c)
+        {
+            parser->unsupported = 1;
+            return NULL;
+        }
+        if((c == ']') && !first)
+        {
+            parser->p++;
+            break;
+        }
+        first = 0;
+
+        if((c == '[') && ((parser->p[1] == ':') || (parser->p[1] == '.') || (parser->p[1] == '=')))
+        {
+            parser->unsupported = 1; // POSIX classes
+            return NULL;
+        }
+
+        parser->p++;
+        lo = (unsigned char)c;
+        if(c == '\\')
+        {
+            unsigned char escaped[32];
+            int kind;
+            int i;
+            memset(escaped, 0, sizeof(escaped));
+            kind = parseEscape(parser, &lo, escaped);
+            if(kind == ESCAPE_UNSUPPORTED)
+            {
+                parser->unsupported = 1;
+                return NULL;
+            }
+            if(kind == ESCAPE_CLASS)
+            {
+                if(*parser->p == '-')
+                {
+                    parser->unsupported = 1;
+                    return NULL;
+                }
+                for(i = 0; i < 32; ++i)
+                    parser->dfa->sets[set][i] |= escaped[i];
+                continue;
+            }
+        }
+
+        hi = lo;
+        if((parser->p[0] == '-') && parser->p[1] && (parser->p[1] != ']'))
+        {
+            parser->p++;
+            hi = (unsigned char)*parser->p++;
+            if(hi == '\\')
+            {
+                unsigned char scratch[32];
+                memset(scratch, 0, sizeof(scratch));
+                if(parseEscape(parser, &hi, scratch) != ESCAPE_LITERAL)
+                {
+                    parser->unsupported = 1;
+                    return NULL;
+                }
+            }
+            if(hi < lo)
+            {
+                parser->unsupported = 1;
+                return NULL;
+            }
+        }
+        setAddRange(parser->dfa->sets[set], lo, hi);
+    }
+
+    if(parser->caseless)
+        setFold(parser->dfa->sets[set]);
+    if(negate)
+        setInvert(parser->dfa->sets[set]);
+
+    node = newNode(NODE_SET, NULL, NULL);
+    node->set = set;
+    return node;
+}
+
+static friskDfaNode *parseAlt(friskDfaParser *parser);
+
+static friskDfaNode *parseAtom(friskDfaParser *parser)
+{
+    friskDfaNode *node;
+    char c = *parser->p++;
+    int literal;
+    int set;
+
+    switch(c)
+    {
+        case '(':
+            if(*parser->p == '?')
+            {
+                if(parser->p[1] != ':')
+                {
+                    parser->unsupported = 1; // lookaround, named groups, inline options, ...
+                    return NULL;
+                }
+                parser->p += 2;
+            }
+            node = parseAlt(parser);
+            if(!node || (*parser->p != ')'))
+            {
+                destroyNode(node);
+                parser->unsupported = 1;
+                return NULL;
+            }
+            parser->p++;
+            return node;
+
+        case '[':
+            return parseClass(parser);
+
+        case '^':
+            return newNode(NODE_BOL, NULL, NULL);
+
+        case '$':
+            return newNode(NODE_EOL, NULL, NULL);
+
+        case '.':
+            set = newSet(parser->dfa);
+            setAddRange(parser->dfa->sets[set], 0, 255);
+            parser->dfa->sets[set]['\n' >> 3] &= (unsigned char)~(1 << ('\n' & 7));
+            break;
+
+        case '\\':
+            set = newSet(parser->dfa);
+            switch(parseEscape(parser, &literal, parser->dfa->sets[set]))
+            {
+                case ESCAPE_UNSUPPORTED:
+                    parser->unsupported = 1;
+                    return NULL;
+                case ESCAPE_LITERAL:
+                    setAdd(parser->dfa->sets[set], literal);
+                    if(parser->caseless)
+                        setFold(parser->dfa->sets[set]);
+                    break;
+            }
+            break;
+
+        default:
+            set = newSet(parser->dfa);
+            setAdd(parser->dfa->sets[set], (unsigned char)c);
+            if(parser->caseless)
+                setFold(parser->dfa->sets[set]);
+            break;
+    }
+
+    node = newNode(NODE_SET, NULL, NULL);
+    node->set = set;
+    return node;
+}
+
+// PCRE treats a '{' that doesn't start a well formed {n}, {n,} or {n,m} as a literal
+static int parseBraces(const char *p, int *min, int *max, const char **end)
+{
+    if(*p++ != '{' || !isdigit((unsigned char)*p))
+        return 0;
+    *min = 0;
+    while(isdigit((unsigned char)*p))
+        *min = (*min * 10) + (*p++ - '0');
+    *max = *min;
+    if(*p == ',')
+    {
+        p++;
+        if(isdigit((unsigned char)*p))
+        {
+            *max = 0;
+            while(isdigit((unsigned char)*p))
+                *max = (*max * 10) + (*p++ - '0');
+        }
+        else
+        {
+            *max = -1;
+        }
+    }
+    if(*p != '}')
+        return 0;
+    *end = p + 1;
+    return 1;
+}
+
+// Whether node can match without consuming anything
+static int nodeNullable(const friskDfaNode *node)
+{
+    switch(node->type)
+    {
+        case NODE_SET:
+            return 0;
+        case NODE_CONCAT:
+            return nodeNullable(node->left) && nodeNullable(node->right);
+        case NODE_ALT:
+            return nodeNullable(node->left) || nodeNullable(node->right);
+        case NODE_REPEAT:
+            return (node->min == 0) || nodeNullable(node->left);
+    }
+    return 1; // NODE_EMPTY, NODE_BOL, NODE_EOL
+}
+
+static friskDfaNode *parseRepeat(friskDfaParser *parser)
+{
+    friskDfaNode *atom = parseAtom(parser);
+    friskDfaNode *node;
+    const char *end;
+    int min;
+    int max;
+    char c;
+
+    if(!atom)
+        return NULL;
+
+    c = *parser->p;
+    if(c == '*')
+    {
+        min = 0;
+        max = -1;
+        end = parser->p + 1;
+    }
+    else if(c == '+')
+    {
+        min = 1;
+        max = -1;
+        end = parser->p + 1;
+    }
+    else if(c == '?')
+    {
+        min = 0;
+        max = 1;
+        end = parser->p + 1;
+    }
+    else if((c != '{') || !parseBraces(parser->p, &min, &max, &end))
+    {
+        return atom;
+    }
+
+    // PCRE stops an unbounded loop as soon as an iteration matches empty, which the DFA can't
+    // mimic: (a?|b)* on "b" is an empty hit to PCRE, and a longer one here
+    if((atom->type == NODE_BOL) || (atom->type == NODE_EOL) || ((max != -1) && (max > 1000)) || (min > 1000) || ((max == -1) && nodeNullable(atom)))
+    {
+        destroyNode(atom);
+        parser->unsupported = 1;
+        return NULL;
+    }
+
+    parser->p = end;
+    node = newNode(NODE_REPEAT, atom, NULL);
+    node->min = min;
+    node->max = max;
+    if(*parser->p == '?')
+    {
+        node->lazy = 1;
+        parser->p++;
+    }
+
+    // Possessive quantifiers and stacked quantifiers
+    c = *parser->p;
+    if((c == '+') || (c == '*') || (c == '?') || ((c == '{') && parseBraces(parser->p, &min, &max, &end)))
+    {
+        destroyNode(node);
+        parser->unsupported = 1;
+        return NULL;
+    }
+    return node;
+}
+
+static friskDfaNode *parseConcat(friskDfaParser *parser)
+{
+    friskDfaNode *node = newNode(NODE_EMPTY, NULL, NULL);
+    while(*parser->p && (*parser->p != '|') && (*parser->p != ')'))
+    {
+        friskDfaNode *atom = parseRepeat(parser);
+        if(!atom)
+        {
+            destroyNode(node);
+            return NULL;
+        }
+        node = newNode(NODE_CONCAT, node, atom);
+    }
+    return node;
+}
+
+static friskDfaNode *parseAlt(friskDfaParser *parser)
+{
+    friskDfaNode *node = parseConcat(parser);
+    while(node && (*parser->p == '|'))
+    {
+        friskDfaNode *right;
+        parser->p++;
+        right = parseConcat(parser);
+        if(!right)
+        {
+            destroyNode(node);
+            return NULL;
+        }
+        node = newNode(NODE_ALT, node, right);
+    }
+    return node;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Compiler
+
+static int emit(friskDfaMachine *m, int op, int x, int y)
+{
+    friskDfaInst *inst;
+    if(m->instCount >= MAX_INSTRUCTIONS)
+        return -1;
+    if(m->instCount == m->instCapacity)
+    {
+        m->instCapacity = m->instCapacity ? m->instCapacity * 2 : 64;
+        m->insts = (friskDfaInst *)realloc(m->insts, sizeof(friskDfaInst) * m->instCapacity);
+    }
+    inst = &m->insts[m->instCount];
+    inst->op = op;
+    inst->x = x;
+    inst->y = y;
+    return m->instCount++;
+}
+
+static void patchSplit(friskDfaMachine *m, int pc, int body, int exit, int lazy)
+{
+    m->insts[pc].x = lazy ? exit : body;
+    m->insts[pc].y = lazy ? body : exit;
+}
+
+// Emits node so that control falls through to whatever gets emitted next. A reverse machine
+// matches the node's text backwards, so concatenations are laid out right to left.
+static int compileNode(friskDfaMachine *m, friskDfaNode *node, int reverse)
+{
+    int pc;
+    int i;
+    switch(node->type)
+    {
+        case NODE_EMPTY:
+            return 1;
+
+        case NODE_SET:
+            return emit(m, OP_BYTES, node->set, 0) >= 0;
+
+        case NODE_BOL:
+            return emit(m, OP_BOL, 0, 0) >= 0;
+
+        case NODE_EOL:
+            return emit(m, OP_EOL, 0, 0) >= 0;
+
+        case NODE_CONCAT:
+            if(reverse)
+                return compileNode(m, node->right, reverse) && compileNode(m, node->left, reverse);
+            return compileNode(m, node->left, reverse) && compileNode(m, node->right, reverse);
+
+        case NODE_ALT:
+        {
+            int jmp;
+            pc = emit(m, OP_SPLIT, 0, 0);
+            if((pc < 0) || !compileNode(m, node->left, reverse))
+                return 0;
+            jmp = emit(m, OP_JMP, 0, 0);
+            if(jmp < 0)
+                return 0;
+            patchSplit(m, pc, pc + 1, m->instCount, 0);
+            if(!compileNode(m, node->right, reverse))
+                return 0;
+            m->insts[jmp].x = m->instCount;
+            return 1;
+        }
+
+        case NODE_REPEAT:
+            for(i = 0; i < node->min; ++i)
+            {
+                if(!compileNode(m, node->left, reverse))
+                    return 0;
+            }
+            if(node->max == -1)
+            {
+                pc = emit(m, OP_SPLIT, 0, 0);
+                if((pc < 0) || !compileNode(m, node->left, reverse) || (emit(m, OP_JMP, pc, 0) < 0))
+                    return 0;
+                patchSplit(m, pc, pc + 1, m->instCount, node->lazy);
+            }
+            else if(node->max > node->min)
+            {
+                // x{0,3} is laid out as (x(x(x)?)?)? so every optional copy can bail to the end
+                int optionalCount = node->max - node->min;
+                int *splits = (int *)malloc(sizeof(int) * optionalCount);
+                for(i = 0; i < optionalCount; ++i)
+                {
+                    splits[i] = emit(m, OP_SPLIT, 0, 0);
+                    if((splits[i] < 0) || !compileNode(m, node->left, reverse))
+                    {
+                        free(splits);
+                        return 0;
+                    }
+                }
+                for(i = 0; i < optionalCount; ++i)
+                    patchSplit(m, splits[i], splits[i] + 1, m->instCount, node->lazy);
+                free(splits);
+            }
+            return 1;
+    }
+    return 0;
+}
+
+static friskDfaMachine *createMachine(friskDfa *dfa, friskDfaNode *root, int reverse)
+{
+    friskDfaMachine *m = (friskDfaMachine *)calloc(1, sizeof(friskDfaMachine));
+    int ok;
+
+    if(reverse)
+    {
+        m->startOp = OP_EOL;
+        m->pendingOp = OP_BOL;
+        m->leftmostFirst = 0;
+        ok = compileNode(m, root, 1);
+    }
+    else
+    {
+        // Unanchored search: a lazy .* in front, which loses to the pattern itself at every step
+        int anySet = newSet(dfa);
+        setAddRange(dfa->sets[anySet], 0, 255);
+        m->startOp = OP_BOL;
+        m->pendingOp = OP_EOL;
+        m->leftmostFirst = 1;
+        emit(m, OP_SPLIT, 3, 1);
+        emit(m, OP_BYTES, anySet, 0);
+        emit(m, OP_JMP, 0, 0);
+        ok = compileNode(m, root, 0);
+    }
+    if(!ok || (emit(m, OP_MATCH, 0, 0) < 0))
+    {
+        free(m->insts);
+        free(m);
+        return NULL;
+    }
+
+    memset(m->buckets, 0xff, sizeof(m->buckets));
+    m->startStates[0] = -1;
+    m->startStates[1] = -1;
+    m->stack = (int *)malloc(sizeof(int) * (m->instCount * 2 + 2));
+    m->seeds = (int *)malloc(sizeof(int) * m->instCount);
+    m->list = (int *)malloc(sizeof(int) * m->instCount);
+    m->visited = (unsigned char *)malloc(m->instCount);
+    return m;
+}
+
+static void destroyMachine(friskDfaMachine *m)
+{
+    int i;
+    if(!m)
+        return;
+    for(i = 0; i < m->stateCount; ++i)
+    {
+        free(m->states[i].pcs);
+        free(m->states[i].next);
+    }
+    free(m->states);
+    free(m->insts);
+    free(m->stack);
+    free(m->seeds);
+    free(m->list);
+    free(m->visited);
+    free(m);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Lazy subset construction
+
+// Follows every non-consuming instruction reachable from seeds (in priority order) and leaves the
+// resulting threads in m->list. assertMask has a (1 << op) bit for each assertion that holds here.
+static int closure(friskDfaMachine *m, const int *seeds, int seedCount, int assertMask)
+{
+    int count = 0;
+    int i;
+
+    memset(m->visited, 0, m->instCount);
+    for(i = 0; i < seedCount; ++i)
+    {
+        int sp = 0;
+        m->stack[sp++] = seeds[i];
+        while(sp)
+        {
+            int pc = m->stack[--sp];
+            friskDfaInst *inst = &m->insts[pc];
+            if(m->visited[pc])
+                continue;
+            m->visited[pc] = 1;
+
+            switch(inst->op)
+            {
+                case OP_BYTES:
+                    m->list[count++] = pc;
+                    break;
+                case OP_MATCH:
+                    m->list[count++] = pc;
+                    if(m->leftmostFirst)
+                        return count;
+                    break;
+                case OP_JMP:
+                    m->stack[sp++] = inst->x;
+                    break;
+                case OP_SPLIT:
+                    m->stack[sp++] = inst->y;
+                    m->stack[sp++] = inst->x;
+                    break;
+                default: // OP_BOL, OP_EOL
+                    if(assertMask & (1 << inst->op))
+                        m->stack[sp++] = pc + 1;
+                    else if(inst->op == m->pendingOp)
+                        m->list[count++] = pc;
+                    break;
+            }
+        }
+    }
+    return count;
+}
+
+static int findState(friskDfa *dfa, friskDfaMachine *m, int count)
+{
+    friskDfaState *state;
+    unsigned int hash = 2166136261u;
+    int bucket;
+    int index;
+    int cost;
+    int i;
+
+    for(i = 0; i < count; ++i)
+        hash = (hash ^ (unsigned int)m->list[i]) * 16777619u;
+    bucket = hash & (STATE_HASH_SIZE - 1);
+    for(index = m->buckets[bucket]; index != -1; index = m->states[index].chain)
+    {
+        state = &m->states[index];
+        if((state->hash == hash) && (state->count == count) && !memcmp(state->pcs, m->list, sizeof(int) * count))
+            return index;
+    }
+
+    cost = sizeof(friskDfaState) + (sizeof(int) * count) + (sizeof(int) * dfa->classCount);
+    if((dfa->memoryUsed + cost) > dfa->memoryLimit)
+        return -1;
+    dfa->memoryUsed += cost;
+
+    if(m->stateCount == m->stateCapacity)
+    {
+        m->stateCapacity = m->stateCapacity ? m->stateCapacity * 2 : 16;
+        m->states = (friskDfaState *)realloc(m->states, sizeof(friskDfaState) * m->stateCapacity);
+    }
+    index = m->stateCount++;
+    state = &m->states[index];
+    state->count = count;
+    state->hash = hash;
+    state->match = 0;
+    state->pcs = (int *)malloc(sizeof(int) * (count ? count : 1));
+    memcpy(state->pcs, m->list, sizeof(int) * count);
+    for(i = 0; i < count; ++i)
+    {
+        if(m->insts[m->list[i]].op == OP_MATCH)
+            state->match = 1;
+    }
+    state->next = (int *)malloc(sizeof(int) * dfa->classCount);
+    memset(state->next, 0xff, sizeof(int) * dfa->classCount);
+    state->chain = m->buckets[bucket];
+    m->buckets[bucket] = index;
+    return index;
+}
+
+static int startState(friskDfa *dfa, friskDfaMachine *m, int atStart)
+{
+    if(m->startStates[atStart] == -1)
+    {
+        int seed = 0;
+        int count = closure(m, &seed, 1, atStart ? (1 << m->startOp) : 0);
+        m->startStates[atStart] = findState(dfa, m, count);
+    }
+    return m->startStates[atStart];
+}
+
+static int nextState(friskDfa *dfa, friskDfaMachine *m, int from, int byteClass)
+{
+    friskDfaState *state = &m->states[from];
+    int byte = dfa->classBytes[byteClass];
+    int seedCount = 0;
+    int count;
+    int to;
+    int i;
+
+    for(i = 0; i < state->count; ++i)
+    {
+        friskDfaInst *inst = &m->insts[state->pcs[i]];
+        if((inst->op == OP_BYTES) && setHas(dfa->sets[inst->x], byte))
+            m->seeds[seedCount++] = state->pcs[i] + 1;
+    }
+    count = closure(m, m->seeds, seedCount, 0);
+    to = findState(dfa, m, count);
+    if(to >= 0)
+        m->states[from].next[byteClass] = to;
+    return to;
+}
+
+// Whether any thread in the state can match once the text runs out here. On empty text both
+// assertions hold at once.
+static int finishMatches(friskDfaMachine *m, int index, int emptyText)
+{
+    friskDfaState *state = &m->states[index];
+    int assertMask = (1 << m->pendingOp) | (emptyText ? (1 << m->startOp) : 0);
+    int i;
+    for(i = 0; i < state->count; ++i)
+    {
+        int pc = state->pcs[i];
+        if(m->insts[pc].op == OP_MATCH)
+            return 1;
+        if(m->insts[pc].op == m->pendingOp)
+        {
+            int seed = pc + 1;
+            int count = closure(m, &seed, 1, assertMask);
+            int j;
+            for(j = 0; j < count; ++j)
+            {
+                if(m->insts[m->list[j]].op == OP_MATCH)
+                    return 1;
+            }
+            state = &m->states[index];
+        }
+    }
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+static int runForward(friskDfa *dfa, const unsigned char *text, int len, int start, int *end)
+{
+    friskDfaMachine *m = dfa->forward;
+    int lastEnd = -1;
+    int index = startState(dfa, m, (start == 0));
+    int i;
+    if(index < 0)
+        return -1;
+
+    if(m->states[index].match)
+        lastEnd = start;
+    for(i = start; i < len; ++i)
+    {
+        int byteClass = dfa->classes[text[i]];
+        int next = m->states[index].next[byteClass];
+        if(next < 0)
+        {
+            next = nextState(dfa, m, index, byteClass);
+            if(next < 0)
+                return -1;
+        }
+        index = next;
+        if(!m->states[index].count)
+            break;
+        if(m->states[index].match)
+            lastEnd = i + 1;
+    }
+    if((i == len) && m->states[index].count && finishMatches(m, index, (len == 0)))
+        lastEnd = len;
+
+    if(lastEnd == -1)
+        return 0;
+    *end = lastEnd;
+    return 1;
+}
+
+static int runReverse(friskDfa *dfa, const unsigned char *text, int len, int start, int end, int *matchStart)
+{
+    friskDfaMachine *m = dfa->reverse;
+    int best = -1;
+    int index = startState(dfa, m, (end == len));
+    int i;
+    if(index < 0)
+        return -1;
+
+    if(m->states[index].match)
+        best = end;
+    for(i = end - 1; i >= start; --i)
+    {
+        int byteClass = dfa->classes[text[i]];
+        int next = m->states[index].next[byteClass];
+        if(next < 0)
+        {
+            next = nextState(dfa, m, index, byteClass);
+            if(next < 0)
+                return -1;
+        }
+        index = next;
+        if(!m->states[index].count)
+            break;
+        if(m->states[index].match)
+            best = i;
+    }
+    if((i < 0) && m->states[index].count && finishMatches(m, index, (len == 0)))
+        best = 0;
+
+    if(best == -1)
+        return 0;
+    *matchStart = best;
+    return 1;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+friskDfa * friskDfaCreate(const char * pattern, int caseless, int memoryLimit)
+{
+    friskDfa *dfa = (friskDfa *)calloc(1, sizeof(friskDfa));
+    friskDfaParser parser;
+    friskDfaNode *root;
+    int i;
+
+    memset(&parser, 0, sizeof(parser));
+    parser.p = pattern;
+    parser.caseless = caseless;
+    parser.dfa = dfa;
+    root = parseAlt(&parser);
+    if(!root || parser.unsupported || *parser.p)
+    {
+        destroyNode(root);
+        friskDfaDestroy(dfa);
+        return NULL;
+    }
+
+    dfa->memoryLimit = memoryLimit;
+    dfa->forward = createMachine(dfa, root, 0);
+    dfa->reverse = createMachine(dfa, root, 1);
+    destroyNode(root);
+    if(!dfa->forward || !dfa->reverse)
+    {
+        friskDfaDestroy(dfa);
+        return NULL;
+    }
+
+    // Split the byte range into classes that no set can tell apart
+    dfa->classCount = 1;
+    for(i = 0; i < dfa->setCount; ++i)
+    {
+        int remap[512];
+        int newCount = 0;
+        int c;
+        memset(remap, 0xff, sizeof(remap));
+        for(c = 0; c < 256; ++c)
+        {
+            int key = (dfa->classes[c] * 2) + setHas(dfa->sets[i], c);
+            if(remap[key] == -1)
+                remap[key] = newCount++;
+            dfa->classes[c] = (unsigned char)remap[key];
+        }
+        dfa->classCount = newCount;
+    }
+    for(i = 255; i >= 0; --i)
+        dfa->classBytes[dfa->classes[i]] = (unsigned char)i;
+    return dfa;
+}
+
+void friskDfaDestroy(friskDfa * dfa)
+{
+    destroyMachine(dfa->forward);
+    destroyMachine(dfa->reverse);
+    free(dfa->sets);
+    free(dfa);
+}
+
+int friskDfaFind(friskDfa * dfa, const char * text, int len, int start, int * matchPos, int * matchLen)
+{
+    const unsigned char *p = (const unsigned char *)text;
+    int end;
+    int rc = runForward(dfa, p, len, start, &end);
+    if(rc <= 0)
+        return rc;
+
+    rc = runReverse(dfa, p, len, start, end, matchPos);
+    if(rc <= 0)
+        return rc;
+
+    *matchLen = end - *matchPos;
+    return 1;
+}
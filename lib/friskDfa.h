@@ -0,0 +1,43 @@
+#ifndef FRISKDFA_H
+#define FRISKDFA_H
+
+// ------------------------------------------------------------------------------------------------
+// Lazily built DFA for the boring subset of regex syntax: literals, classes, escapes like \d \w \s,
+// groups, alternation, greedy/lazy quantifiers and ^ $. Anything fancier (backreferences,
+// lookaround, inline options, \b, ...) makes friskDfaCreate() return NULL, and the caller should
+// stick with PCRE. So does an unbounded repeat of something that can match empty, like (a?|b)*,
+// since PCRE's rule of ending the loop on an empty iteration can't be followed here.
+//
+// States are built on demand while scanning and cached, so every byte of a line is looked at a
+// fixed number of times no matter what the pattern is. The forward pass finds where the leftmost
+// match (with PCRE's leftmost-first rules) ends, and a reverse pass from there finds where it
+// starts.
+
+#define FRISK_DFA_MEMORY_LIMIT (2 * 1024 * 1024)
+
+struct friskDfaMachine;
+
+typedef struct friskDfa
+{
+    unsigned char (*sets)[32];    // bitsets of bytes, one per character-consuming instruction
+    int setCount;
+    unsigned char classes[256];   // byte -> equivalence class across all sets
+    unsigned char classBytes[256]; // class -> a byte from that class
+    int classCount;
+    struct friskDfaMachine *forward;
+    struct friskDfaMachine *reverse;
+    int memoryUsed;
+    int memoryLimit;
+} friskDfa;
+
+// Returns NULL if the pattern uses anything the DFA doesn't handle. The pattern is assumed to
+// have already compiled successfully with PCRE.
+friskDfa * friskDfaCreate(const char * pattern, int caseless, int memoryLimit);
+void friskDfaDestroy(friskDfa * dfa);
+
+// Same contract as pcre_exec on a single line: finds the leftmost hit at or after start. Returns 1
+// on a hit, 0 on no hit, and -1 if the state cache grew past memoryLimit (the DFA is useless from
+// then on and the caller should switch to PCRE).
+int friskDfaFind(friskDfa * dfa, const char * text, int len, int start, int * matchPos, int * matchLen);
+
+#endif
@@ -0,0 +1,296 @@
+#include "friskEncoding.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SNIFF_SIZE (1024)
+
+// ------------------------------------------------------------------------------------------------
+
+friskEncoding friskDetectEncoding(const char * data, int size)
+{
+    const unsigned char *s = (const unsigned char *)data;
+    int sample = ((size < SNIFF_SIZE) ? size : SNIFF_SIZE) & ~1;
+    int evenZeros = 0;
+    int oddZeros = 0;
+    int i;
+
+    if((size >= 3) && (s[0] == 0xEF) && (s[1] == 0xBB) && (s[2] == 0xBF))
+        return FE_UTF8_BOM;
+    if((size >= 2) && (s[0] == 0xFF) && (s[1] == 0xFE))
+        return FE_UTF16LE;
+    if((size >= 2) && (s[0] == 0xFE) && (s[1] == 0xFF))
+        return FE_UTF16BE;
+
+    // Mostly-ASCII UTF-16 has a zero in every other byte and nowhere else
+    if(sample < 4)
+        return FE_BYTES;
+    for(i = 0; i < sample; i += 2)
+    {
+        if(!s[i])
+            evenZeros++;
+        if(!s[i + 1])
+            oddZeros++;
+    }
+    if(!evenZeros && (oddZeros * 4 >= sample / 2 * 3))
+        return FE_UTF16LE;
+    if(!oddZeros && (evenZeros * 4 >= sample / 2 * 3))
+        return FE_UTF16BE;
+    return FE_BYTES;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+static char * appendUtf8(char * out, unsigned int cp)
+{
+    if(cp < 0x80)
+    {
+        *out++ = (char)cp;
+    }
+    else if(cp < 0x800)
+    {
+        *out++ = (char)(0xC0 | (cp >> 6));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    }
+    else if(cp < 0x10000)
+    {
+        *out++ = (char)(0xE0 | (cp >> 12));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        *out++ = (char)(0xF0 | (cp >> 18));
+        *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
+
+// Loose decode of one character: surrogates are allowed (see friskDecodeText), and anything
+// malformed comes back as a single byte with its own value.
+static int readUtf8(const unsigned char * s, int len, unsigned int * cp)
+{
+    int count;
+    int i;
+    if(s[0] < 0xC2)
+    {
+        *cp = s[0];
+        return 1;
+    }
+    if(s[0] < 0xE0)
+    {
+        count = 2;
+        *cp = s[0] & 0x1F;
+    }
+    else if(s[0] < 0xF0)
+    {
+        count = 3;
+        *cp = s[0] & 0x0F;
+    }
+    else if(s[0] < 0xF5)
+    {
+        count = 4;
+        *cp = s[0] & 0x07;
+    }
+    else
+    {
+        *cp = s[0];
+        return 1;
+    }
+    if(count > len)
+    {
+        *cp = s[0];
+        return 1;
+    }
+    for(i = 1; i < count; ++i)
+    {
+        if((s[i] & 0xC0) != 0x80)
+        {
+            *cp = s[0];
+            return 1;
+        }
+        *cp = (*cp << 6) | (s[i] & 0x3F);
+    }
+    return count;
+}
+
+static unsigned int readUnit(const unsigned char * s, friskEncoding encoding)
+{
+    if(encoding == FE_UTF16LE)
+        return s[0] | (s[1] << 8);
+    return (s[0] << 8) | s[1];
+}
+
+static unsigned char * writeUnit(unsigned char * out, unsigned int unit, friskEncoding encoding)
+{
+    if(encoding == FE_UTF16LE)
+    {
+        *out++ = (unsigned char)(unit & 0xFF);
+        *out++ = (unsigned char)(unit >> 8);
+    }
+    else
+    {
+        *out++ = (unsigned char)(unit >> 8);
+        *out++ = (unsigned char)(unit & 0xFF);
+    }
+    return out;
+}
+
+int friskDecodeText(char ** data, int * size, friskEncoding encoding)
+{
+    const unsigned char *s = (const unsigned char *)*data;
+    const unsigned char *end;
+    char *decoded;
+    char *out;
+    int bom = 0;
+
+    if(encoding == FE_UTF8_BOM)
+    {
+        *size -= 3;
+        memmove(*data, *data + 3, *size + 1);
+        return 1;
+    }
+    if((encoding != FE_UTF16LE) && (encoding != FE_UTF16BE))
+        return 0;
+
+    // The sniffed kind doesn't have a BOM
+    if((*size >= 2) && (readUnit(s, encoding) == 0xFEFF))
+    {
+        s += 2;
+        bom = 1;
+    }
+    end = (const unsigned char *)*data + (*size & ~1);
+
+    // A unit never turns into more than 3 bytes, and a surrogate pair into 4
+    decoded = (char *)malloc((end - s) / 2 * 3 + 1);
+    out = decoded;
+    while(s < end)
+    {
+        unsigned int cp = readUnit(s, encoding);
+        s += 2;
+        if((cp >= 0xD800) && (cp < 0xDC00) && (s < end))
+        {
+            unsigned int low = readUnit(s, encoding);
+            if((low >= 0xDC00) && (low < 0xE000))
+            {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                s += 2;
+            }
+        }
+        out = appendUtf8(out, cp);
+    }
+    *out = 0;
+
+    free(*data);
+    *data = decoded;
+    *size = (int)(out - decoded);
+    return bom;
+}
+
+char * friskEncodeText(const char * text, int len, friskEncoding encoding, int bom, int * size)
+{
+    const unsigned char *s = (const unsigned char *)text;
+    const unsigned char *end = s + len;
+    unsigned char *encoded;
+    unsigned char *out;
+
+    if((encoding != FE_UTF16LE) && (encoding != FE_UTF16BE))
+    {
+        int bomSize = (bom && (encoding == FE_UTF8_BOM)) ? 3 : 0;
+        encoded = (unsigned char *)malloc(bomSize + len + 1);
+        memcpy(encoded, "\xEF\xBB\xBF", bomSize);
+        memcpy(encoded + bomSize, text, len);
+        encoded[bomSize + len] = 0;
+        *size = bomSize + len;
+        return (char *)encoded;
+    }
+
+    // Every UTF-8 byte becomes at most 2 bytes of UTF-16, plus the BOM and a terminator
+    encoded = (unsigned char *)malloc(len * 2 + 4);
+    out = bom ? writeUnit(encoded, 0xFEFF, encoding) : encoded;
+    while(s < end)
+    {
+        unsigned int cp;
+        s += readUtf8(s, (int)(end - s), &cp);
+        if(cp >= 0x10000)
+        {
+            cp -= 0x10000;
+            out = writeUnit(out, 0xD800 + (cp >> 10), encoding);
+            out = writeUnit(out, 0xDC00 + (cp & 0x3FF), encoding);
+        }
+        else
+        {
+            out = writeUnit(out, cp, encoding);
+        }
+    }
+    out[0] = out[1] = 0;
+    *size = (int)(out - encoded);
+    return (char *)encoded;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+int friskValidateUtf8(const char * text, int len)
+{
+    const unsigned char *s = (const unsigned char *)text;
+    int i = 0;
+    while(i < len)
+    {
+        unsigned char c;
+        unsigned char lo = 0x80;
+        unsigned char hi = 0xBF;
+        int count;
+        int j;
+
+        // Most text is ASCII, so skip it 8 bytes at a time
+        while(i + 8 <= len)
+        {
+            unsigned long long word;
+            memcpy(&word, s + i, 8);
+            if(word & 0x8080808080808080ULL)
+                break;
+            i += 8;
+        }
+        if(i >= len)
+            break;
+
+        c = s[i];
+        if(c < 0x80)
+        {
+            i++;
+            continue;
+        }
+
+        // The ranges that rule out overlong forms, surrogates and anything past U+10FFFF
+        if((c >= 0xC2) && (c <= 0xDF))
+            count = 1;
+        else if((c >= 0xE0) && (c <= 0xEF))
+            count = 2;
+        else if((c >= 0xF0) && (c <= 0xF4))
+            count = 3;
+        else
+            return i;
+        if(c == 0xE0)
+            lo = 0xA0;
+        else if(c == 0xED)
+            hi = 0x9F;
+        else if(c == 0xF0)
+            lo = 0x90;
+        else if(c == 0xF4)
+            hi = 0x8F;
+
+        if(i + count >= len)
+            return i;
+        if((s[i + 1] < lo) || (s[i + 1] > hi))
+            return i;
+        for(j = 2; j <= count; ++j)
+        {
+            if((s[i + j] & 0xC0) != 0x80)
+                return i;
+        }
+        i += count + 1;
+    }
+    return -1;
+}
@@ -0,0 +1,32 @@
+#ifndef FRISKENCODING_H
+#define FRISKENCODING_H
+
+// ------------------------------------------------------------------------------------------------
+// The search engine only ever looks at UTF-8 (or plain 8-bit) text. UTF-16 files are transcoded to
+// UTF-8 right after they're read, and back again if a replace has to write them out.
+
+typedef enum friskEncoding
+{
+    FE_BYTES = 0,  // no BOM, not UTF-16: searched as is
+    FE_UTF8_BOM,
+    FE_UTF16LE,
+    FE_UTF16BE,
+
+    FE_COUNT
+} friskEncoding;
+
+// Looks for a BOM, and failing that for the telltale every-other-byte-is-zero of BOM-less UTF-16.
+friskEncoding friskDetectEncoding(const char * data, int size);
+
+// Replaces *data (malloc'd, NUL terminated) with its UTF-8 equivalent, minus any BOM, and returns
+// whether there was one. Lone surrogates are kept as 3 byte sequences so friskEncodeText() can put
+// them back exactly.
+int friskDecodeText(char ** data, int * size, friskEncoding encoding);
+
+// The reverse of friskDecodeText(). Returns a new malloc'd, NUL terminated buffer.
+char * friskEncodeText(const char * text, int len, friskEncoding encoding, int bom, int * size);
+
+// Returns -1 if text is valid UTF-8, otherwise the offset of the first byte that isn't.
+int friskValidateUtf8(const char * text, int len);
+
+#endif
@@ -0,0 +1,314 @@
+#include "friskFind.h"
+#include "friskRegexCache.h"
+
+#include "dynString.h"
+
+#include <pcre.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_CHUNK_ROWS (4096)
+
+// Roughly how common bytes are in source and text, most common first. A literal find memchr()s
+// for whichever byte of the needle shows up latest in here; anything not listed counts as rarest.
+static const char *commonBytes = " etaoinsrlhdcum\tpfgybw.,_()=;\"vk-/:x0j1q2z>*";
+
+typedef struct findQuery
+{
+    int flags;
+    char *needle;    // folded unless FFF_CASE_SENSITIVE
+    int needleLength;
+    int rarePos;     // which needle byte to memchr for
+    friskRegexCache *cache;
+    friskCachedRegex *cached;
+    pcre *regex;
+    pcre_extra *extra;
+} findQuery;
+
+// ------------------------------------------------------------------------------------------------
+
+static char foldByte(char c)
+{
+    return ((c >= 'A') && (c <= 'Z')) ? (char)(c + ('a' - 'A')) : c;
+}
+
+static int isWordByte(char c)
+{
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) || (c == '_') || ((unsigned char)c >= 0x80);
+}
+
+static void reserveText(friskFind *find, int extra)
+{
+    if(find->length + extra > find->capacity)
+    {
+        find->capacity = (find->length + extra) * 2;
+        find->text = (char *)realloc(find->text, find->capacity);
+        find->lower = (char *)realloc(find->lower, find->capacity);
+    }
+}
+
+// Copies in any rows the view has gained since last time
+static void indexRows(friskFind *find)
+{
+    int total = friskViewRowCount(find->view);
+    while(find->rowCount < total)
+    {
+        friskRow *rows;
+        int count = friskViewGetRows(find->view, find->rowCount, INDEX_CHUNK_ROWS, &rows);
+        int i;
+        if(find->rowCount + count + 1 > find->rowCapacity)
+        {
+            find->rowCapacity = (find->rowCount + count + 1) * 2;
+            find->rowStarts = (int *)realloc(find->rowStarts, sizeof(int) * find->rowCapacity);
+        }
+        for(i = 0; i < count; ++i)
+        {
+            int j;
+            reserveText(find, rows[i].length + 1);
+            memcpy(find->text + find->length, rows[i].text, rows[i].length);
+            for(j = 0; j < rows[i].length; ++j)
+                find->lower[find->length + j] = foldByte(rows[i].text[j]);
+            find->length += rows[i].length;
+            find->text[find->length] = '\n';
+            find->lower[find->length] = '\n';
+            find->length++;
+            find->rowStarts[++find->rowCount] = find->length;
+        }
+    }
+}
+
+// Last row that starts at or before offset
+static int rowAt(friskFind *find, int offset)
+{
+    int low = 0;
+    int high = find->rowCount - 1;
+    while(low < high)
+    {
+        int mid = (low + high + 1) / 2;
+        if(find->rowStarts[mid] <= offset)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    return low;
+}
+
+// Typing in a find box reruns the same few regexes over and over, so they come from the cache
+static int prepareQuery(friskFind *find, findQuery *query, const char *pattern, int flags, char **error)
+{
+    memset(query, 0, sizeof(findQuery));
+    query->flags = flags;
+    if(flags & FFF_REGEX)
+    {
+        const char *pcreError;
+        int options = PCRE_MULTILINE;
+        if(!(flags & FFF_CASE_SENSITIVE))
+            options |= PCRE_CASELESS;
+        query->cache = find->view->context->regexCache;
+        query->cached = friskRegexCacheGet(query->cache, pattern, options, &pcreError);
+        if(!query->cached)
+        {
+            if(error)
+                dsCopy(error, pcreError);
+            return 0;
+        }
+        query->regex = query->cached->regex;
+        query->extra = query->cached->study;
+    }
+    else
+    {
+        int bestRank = -1;
+        int i;
+        query->needleLength = (int)strlen(pattern);
+        query->needle = (char *)malloc(query->needleLength + 1);
+        for(i = 0; i <= query->needleLength; ++i)
+            query->needle[i] = (flags & FFF_CASE_SENSITIVE) ? pattern[i] : foldByte(pattern[i]);
+        for(i = 0; i < query->needleLength; ++i)
+        {
+            const char *common = strchr(commonBytes, query->needle[i]);
+            int rank = common ? (int)(common - commonBytes) : (int)strlen(commonBytes);
+            if(rank > bestRank)
+            {
+                bestRank = rank;
+                query->rarePos = i;
+            }
+        }
+    }
+    return 1;
+}
+
+static void destroyQuery(findQuery *query)
+{
+    free(query->needle);
+    if(query->cached)
+        friskRegexCachePut(query->cache, query->cached);
+}
+
+static int findLiteral(friskFind *find, findQuery *query, int pos, int *start)
+{
+    const char *haystack = (query->flags & FFF_CASE_SENSITIVE) ? find->text : find->lower;
+    const char *p = haystack + pos + query->rarePos;
+    const char *end = haystack + find->length - (query->needleLength - query->rarePos - 1);
+    char rare = query->needle[query->rarePos];
+    while(p < end)
+    {
+        p = (const char *)memchr(p, rare, end - p);
+        if(!p)
+            break;
+        if(!memcmp(p - query->rarePos, query->needle, query->needleLength))
+        {
+            *start = (int)(p - query->rarePos - haystack);
+            return 1;
+        }
+        p++;
+    }
+    return 0;
+}
+
+static int findRegex(friskFind *find, findQuery *query, int pos, int *start, int *length)
+{
+    int ovector[3];
+    while(pos < find->length)
+    {
+        int rc = pcre_exec(query->regex, query->extra, find->text, find->length, pos, 0, ovector, 3);
+        int rowEnd;
+        if(rc < 0)
+            return 0;
+        if(!memchr(find->text + ovector[0], '\n', ovector[1] - ovector[0]))
+        {
+            *start = ovector[0];
+            *length = ovector[1] - ovector[0];
+            return 1;
+        }
+
+        // That hit ran into the next row; look again with the subject cut off at the row's end
+        rowEnd = find->rowStarts[rowAt(find, ovector[0]) + 1] - 1;
+        rc = pcre_exec(query->regex, query->extra, find->text, rowEnd, ovector[0], 0, ovector, 3);
+        if(rc >= 0)
+        {
+            *start = ovector[0];
+            *length = ovector[1] - ovector[0];
+            return 1;
+        }
+        pos = rowEnd + 1;
+    }
+    return 0;
+}
+
+// Next hit at or after pos in the flat buffer
+static int nextHit(friskFind *find, findQuery *query, int pos, int *start, int *length)
+{
+    while(pos < find->length)
+    {
+        if(query->regex)
+        {
+            if(!findRegex(find, query, pos, start, length))
+                return 0;
+        }
+        else
+        {
+            if(!query->needleLength || memchr(query->needle, '\n', query->needleLength) || !findLiteral(find, query, pos, start))
+                return 0;
+            *length = query->needleLength;
+        }
+
+        if(*length && (!(query->flags & FFF_WHOLE_WORDS)
+            || (((*start == 0) || !isWordByte(find->text[*start - 1])) && !isWordByte(find->text[*start + *length]))))
+        {
+            return 1;
+        }
+        pos = *start + 1;
+    }
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+friskFind * friskFindCreate(friskContext * context)
+{
+    friskFind *find = (friskFind *)calloc(1, sizeof(friskFind));
+    find->view = friskViewCreate(context);
+    find->rowCapacity = 64;
+    find->rowStarts = (int *)calloc(find->rowCapacity, sizeof(int));
+    return find;
+}
+
+void friskFindDestroy(friskFind * find)
+{
+    friskViewDestroy(find->view);
+    free(find->text);
+    free(find->lower);
+    free(find->rowStarts);
+    free(find->hits);
+    free(find);
+}
+
+int friskFindAll(friskFind * find, const char * pattern, int flags, friskFindHit ** hits, char ** error)
+{
+    findQuery query;
+    int count = 0;
+    int pos = 0;
+    int start;
+    int length;
+    int row = 0;
+
+    *hits = NULL;
+    if(!prepareQuery(find, &query, pattern, flags, error))
+        return -1;
+    indexRows(find);
+
+    while(nextHit(find, &query, pos, &start, &length))
+    {
+        if(count + 1 > find->hitCapacity)
+        {
+            find->hitCapacity = (count + 1) * 2;
+            find->hits = (friskFindHit *)realloc(find->hits, sizeof(friskFindHit) * find->hitCapacity);
+        }
+
+        // Hits come in order, so the row only ever moves forward
+        while(find->rowStarts[row + 1] <= start)
+            row++;
+        find->hits[count].row = row;
+        find->hits[count].offset = start - find->rowStarts[row];
+        find->hits[count].length = length;
+        count++;
+        pos = start + length;
+    }
+
+    destroyQuery(&query);
+    *hits = find->hits;
+    return count;
+}
+
+int friskFindNext(friskFind * find, const char * pattern, int flags, int row, int offset, friskFindHit * hit, char ** error)
+{
+    findQuery query;
+    int pos;
+    int start;
+    int length;
+    int found;
+
+    if(!prepareQuery(find, &query, pattern, flags, error))
+        return -1;
+    indexRows(find);
+
+    pos = 0;
+    if((row >= 0) && (row < find->rowCount))
+    {
+        pos = find->rowStarts[row] + ((offset > 0) ? offset : 0);
+        if(pos >= find->rowStarts[row + 1])
+            pos = find->rowStarts[row + 1];
+    }
+    found = nextHit(find, &query, pos, &start, &length);
+    if(!found && pos)
+        found = nextHit(find, &query, 0, &start, &length);
+    if(found)
+    {
+        hit->row = rowAt(find, start);
+        hit->offset = start - find->rowStarts[hit->row];
+        hit->length = length;
+    }
+
+    destroyQuery(&query);
+    return found;
+}
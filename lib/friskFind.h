@@ -0,0 +1,52 @@
+#ifndef FRISKFIND_H
+#define FRISKFIND_H
+
+#include "friskView.h"
+
+// ------------------------------------------------------------------------------------------------
+// Find-in-results over the rows of a search's results (same numbering as friskView). The text of
+// every row is copied once into one flat buffer (rows separated by '\n') alongside a lowercased
+// shadow of it, so a case-insensitive literal find is a straight memchr/memcmp scan with no
+// per-byte folding, and nothing has to be pulled back out of the frontend's control. Rows added
+// since the last call are appended first, so a find can be run while the search is still going.
+
+typedef enum friskFindFlag
+{
+    FFF_CASE_SENSITIVE = (1 << 0),
+    FFF_WHOLE_WORDS    = (1 << 1), // hit can't have a word character on either side
+    FFF_REGEX          = (1 << 2)
+} friskFindFlag;
+
+typedef struct friskFindHit
+{
+    int row;
+    int offset; // relative to the row's text
+    int length;
+} friskFindHit;
+
+typedef struct friskFind
+{
+    friskView * view;     // private, so finding never moves a frontend's row window
+    char * text;          // every row's text, each followed by '\n'
+    char * lower;         // text with A-Z folded, same offsets
+    int length;
+    int capacity;
+    int * rowStarts;      // rowStarts[i] is where row i starts in text; one extra at the end
+    int rowCount;
+    int rowCapacity;
+    friskFindHit * hits;  // the last friskFindAll() results
+    int hitCapacity;
+} friskFind;
+
+friskFind * friskFindCreate(friskContext * context);
+void friskFindDestroy(friskFind * find);
+
+// Finds every hit, in order. *hits belongs to find and lasts until the next call. Returns -1 (and
+// fills in *error, a dynString) if the regex doesn't compile.
+int friskFindAll(friskFind * find, const char * pattern, int flags, friskFindHit ** hits, char ** error);
+
+// Finds the first hit starting at or after offset in row, wrapping around to the top. Returns 1
+// on a hit, 0 if there isn't one anywhere, or -1 on a bad regex.
+int friskFindNext(friskFind * find, const char * pattern, int flags, int row, int offset, friskFindHit * hit, char ** error);
+
+#endif
@@ -0,0 +1,321 @@
+#include "friskIgnore.h"
+#include "friskContext.h"
+
+#include "dynArray.h"
+#include "dynString.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FRISK_PLATFORM_WIN32
+#define FRISK_PATH_SEPARATOR '\\'
+#else
+#define FRISK_PATH_SEPARATOR '/'
+#endif
+
+// Later files beat earlier ones, same as later lines in one file
+static const char *ignoreFilenames[] =
+{
+    ".gitignore",
+    ".ignore",
+    ".friskignore",
+    NULL
+};
+
+// ------------------------------------------------------------------------------------------------
+
+static void concatEscaped(char **regex, char c)
+{
+    if(((unsigned char)c < 0x80) && !isalnum((unsigned char)c))
+        dsConcatLen(regex, "\\", 1);
+    dsConcatLen(regex, &c, 1);
+}
+
+// Turns one gitignore glob (already stripped of '!' and any trailing '/') into an anchored regex
+// over the path relative to the ignore file's directory.
+static void convertGlob(char **regex, const char *glob)
+{
+    const char *c = glob;
+
+    // A slash anywhere but the end anchors the pattern; otherwise it matches at any depth
+    if(strchr(glob, '/'))
+    {
+        dsConcat(regex, "^");
+        if(*c == '/')
+            c++;
+    }
+    else
+    {
+        dsConcat(regex, "^(?:.*/)?");
+    }
+
+    for(; *c; ++c)
+    {
+        int atSegmentStart = ((c == glob) || (c[-1] == '/'));
+        if((c[0] == '*') && (c[1] == '*') && atSegmentStart && ((c[2] == '/') || !c[2]))
+        {
+            if(c[2] == '/')
+            {
+                dsConcat(regex, "(?:.*/)?"); // "**/": any number of directories, even none
+                c += 2;
+            }
+            else
+            {
+                dsConcat(regex, ".*");       // trailing "/**": everything inside
+                c += 1;
+            }
+        }
+        else if(*c == '*')
+        {
+            dsConcat(regex, "[^/]*");
+            while(c[1] == '*')
+                c++;
+        }
+        else if(*c == '?')
+        {
+            dsConcat(regex, "[^/]");
+        }
+        else if((*c == '[') && strchr(c + 1, ']'))
+        {
+            const char *end;
+            dsConcat(regex, "[");
+            c++;
+            if((*c == '!') || (*c == '^'))
+            {
+                dsConcat(regex, "^");
+                c++;
+            }
+            end = strchr((*c == ']') ? (c + 1) : c, ']');
+            if(!end)
+                end = c + strlen(c); // "[]" with nothing after: let PCRE complain, we skip the rule
+            for(; c < end; ++c)
+            {
+                if((*c == '\\') || (*c == '[') || ((*c == ']')))
+                    dsConcatLen(regex, "\\", 1);
+                dsConcatLen(regex, c, 1);
+            }
+            dsConcat(regex, "]");
+        }
+        else if((*c == '\\') && c[1])
+        {
+            concatEscaped(regex, *++c);
+        }
+        else
+        {
+            concatEscaped(regex, *c);
+        }
+    }
+    dsConcat(regex, "$");
+}
+
+// Parses one ignore file's lines onto the end of the rule lists
+static void parseIgnoreFile(const char *contents, char ***globs, int **flags, int *count)
+{
+    const char *line = contents;
+    while(line && *line)
+    {
+        const char *end = strchr(line, '\n');
+        const char *next = end ? (end + 1) : NULL;
+        char *glob = NULL;
+        int negated = 0;
+        int directoryOnly = 0;
+        if(!end)
+            end = line + strlen(line);
+
+        // Trailing whitespace doesn't count unless it's escaped
+        while((end > line) && ((end[-1] == '\r') || (end[-1] == ' ') || (end[-1] == '\t')))
+        {
+            if((end[-1] == ' ') && (end - 1 > line) && (end[-2] == '\\'))
+                break;
+            end--;
+        }
+        if((end > line) && (*line == '!'))
+        {
+            negated = 1;
+            line++;
+        }
+        if((end > line) && (end[-1] == '/'))
+        {
+            directoryOnly = 1;
+            end--;
+        }
+        if((end > line) && (*line != '#'))
+        {
+            dsCopyLen(&glob, line, (int)(end - line));
+            daPush(globs, glob);
+            *flags = (int *)realloc(*flags, sizeof(int) * (*count + 1));
+            (*flags)[(*count)++] = (negated ? 1 : 0) | (directoryOnly ? 2 : 0);
+        }
+        line = next;
+    }
+}
+
+static pcre *compileRules(char **regexes, int *flags, int count, int forDirectories)
+{
+    char *combined = NULL;
+    const char *error;
+    int erroffset;
+    int options = 0;
+    pcre *regex;
+    int i;
+
+#if defined(FRISK_PLATFORM_WIN32) || defined(FRISK_PLATFORM_OSX)
+    options |= PCRE_CASELESS;
+#endif
+
+    // Last rule first, so the alternative PCRE picks is the rule that wins. Directory-only rules
+    // still take up a group when matching files so the group numbers line up.
+    for(i = count - 1; i >= 0; --i)
+    {
+        if(combined)
+            dsConcat(&combined, "|");
+        dsConcat(&combined, "(");
+        if(!forDirectories && (flags[i] & 2))
+            dsConcat(&combined, "(?!)");
+        else
+            dsConcat(&combined, regexes[i]);
+        dsConcat(&combined, ")");
+    }
+    regex = pcre_compile(combined, options, &error, &erroffset, NULL);
+    dsDestroy(&combined);
+    return regex;
+}
+
+friskIgnore * friskIgnoreLoad(friskIgnore * parent, const char * directory)
+{
+    friskIgnore *ignore;
+    char **globs = NULL;
+    char **regexes = NULL;
+    int *flags = NULL;
+    int count = 0;
+    int i;
+
+    for(i = 0; ignoreFilenames[i]; ++i)
+    {
+        char *filename = dsDup(directory);
+        char *contents = NULL;
+        int size;
+        int len = dsLength(&filename);
+        if(len && (filename[len - 1] != FRISK_PATH_SEPARATOR))
+        {
+            char separator = FRISK_PATH_SEPARATOR;
+            dsConcatLen(&filename, &separator, 1);
+        }
+        dsConcat(&filename, ignoreFilenames[i]);
+        if(friskReadEntireFile(filename, &contents, &size, 0, 0))
+        {
+            parseIgnoreFile(contents, &globs, &flags, &count);
+            free(contents);
+        }
+        dsDestroy(&filename);
+    }
+    if(!count)
+    {
+        daDestroyStrings(&globs);
+        free(flags);
+        return parent ? friskIgnoreRetain(parent) : NULL;
+    }
+
+    // A rule that doesn't make a valid regex can't match anything
+    for(i = 0; i < count; ++i)
+    {
+        char *regex = NULL;
+        const char *error;
+        int erroffset;
+        pcre *check;
+        convertGlob(&regex, globs[i]);
+        check = pcre_compile(regex, 0, &error, &erroffset, NULL);
+        if(check)
+            pcre_free(check);
+        else
+            dsCopy(&regex, "(?!)");
+        daPush(&regexes, regex);
+    }
+
+    ignore = (friskIgnore *)calloc(1, sizeof(friskIgnore));
+    ignore->parent = parent ? friskIgnoreRetain(parent) : NULL;
+    ignore->base = dsDup(directory);
+    ignore->baseLength = dsLength(&ignore->base);
+    ignore->fileRegex = compileRules(regexes, flags, count, 0);
+    ignore->directoryRegex = compileRules(regexes, flags, count, 1);
+    ignore->ruleCount = count;
+    ignore->negated = (int *)malloc(sizeof(int) * (count + 1));
+    ignore->negated[0] = 0;
+    for(i = 0; i < count; ++i)
+        ignore->negated[count - i] = flags[i] & 1;
+    ignore->refs = 1;
+
+    daDestroyStrings(&globs);
+    daDestroyStrings(&regexes);
+    free(flags);
+    return ignore;
+}
+
+friskIgnore * friskIgnoreRetain(friskIgnore * ignore)
+{
+    ignore->refs++;
+    return ignore;
+}
+
+void friskIgnoreRelease(friskIgnore * ignore)
+{
+    if(!ignore || (--ignore->refs > 0))
+        return;
+    if(ignore->parent)
+        friskIgnoreRelease(ignore->parent);
+    if(ignore->fileRegex)
+        pcre_free(ignore->fileRegex);
+    if(ignore->directoryRegex)
+        pcre_free(ignore->directoryRegex);
+    dsDestroy(&ignore->base);
+    free(ignore->negated);
+    free(ignore);
+}
+
+int friskIgnoreMatches(friskIgnore * ignore, const char * path, int isDirectory)
+{
+    for(; ignore; ignore = ignore->parent)
+    {
+        pcre *regex = isDirectory ? ignore->directoryRegex : ignore->fileRegex;
+        const char *relative = path + ignore->baseLength;
+        int smallOvector[48];
+        int *ovector = smallOvector;
+        int ovectorSize = (ignore->ruleCount + 1) * 3;
+        int rc;
+#ifdef FRISK_PLATFORM_WIN32
+        char *converted;
+        char *c;
+#endif
+
+        if(!regex || strncmp(path, ignore->base, ignore->baseLength))
+            continue;
+        if(*relative == FRISK_PATH_SEPARATOR)
+            relative++;
+
+        // pcre_exec wants room for every group up to the one that matched
+        if(ovectorSize > 48)
+            ovector = (int *)malloc(sizeof(int) * ovectorSize);
+
+#ifdef FRISK_PLATFORM_WIN32
+        // The rules are written with forward slashes
+        converted = dsDup(relative);
+        for(c = converted; *c; ++c)
+        {
+            if(*c == '\\')
+                *c = '/';
+        }
+        rc = pcre_exec(regex, NULL, converted, (int)strlen(converted), 0, 0, ovector, ovectorSize);
+        dsDestroy(&converted);
+#else
+        rc = pcre_exec(regex, NULL, relative, (int)strlen(relative), 0, 0, ovector, ovectorSize);
+#endif
+        if(ovector != smallOvector)
+            free(ovector);
+
+        // Only the winning rule's group is set, and it's the highest one set
+        if(rc > 1)
+            return !ignore->negated[rc - 1];
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef FRISKIGNORE_H
+#define FRISKIGNORE_H
+
+#include <pcre.h>
+
+// ------------------------------------------------------------------------------------------------
+// .gitignore / .ignore / .friskignore rules, with gitignore semantics: later rules beat earlier
+// ones, a deeper directory's rules beat its parents', '!' re-includes, a trailing '/' only matches
+// directories, and a pattern with a '/' in it is anchored to the directory its file is in.
+//
+// Every directory that has ignore files gets one node holding its rules compiled down to a pair of
+// PCRE alternations (one for files, one for directories), built once when the walker gets there.
+// Directories without ignore files just share their parent's node, so checking a path costs one
+// pcre_exec per ancestor that actually had rules.
+
+typedef struct friskIgnore
+{
+    struct friskIgnore * parent;
+    char * base;           // the directory the rules are relative to
+    int baseLength;
+    pcre * fileRegex;      // either can be NULL if the combined rules somehow didn't compile
+    pcre * directoryRegex;
+    int * negated;         // capture group -> whether that rule was a '!' rule
+    int ruleCount;
+    int refs;
+} friskIgnore;
+
+// Returns the rules in effect inside directory: parent's plus whatever ignore files directory has.
+// parent may be NULL, and so may the result (nothing is ignored). The caller owns one reference.
+friskIgnore * friskIgnoreLoad(friskIgnore * parent, const char * directory);
+friskIgnore * friskIgnoreRetain(friskIgnore * ignore);
+void friskIgnoreRelease(friskIgnore * ignore);
+
+// path is a full path under the directory ignore was loaded for (as built by the walker).
+int friskIgnoreMatches(friskIgnore * ignore, const char * path, int isDirectory);
+
+#endif
@@ -0,0 +1,171 @@
+#include "friskMultiMatch.h"
+
+#include "dynArray.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+friskMultiMatch * friskMultiMatchCreate(char ** patterns, int caseSensitive)
+{
+    friskMultiMatch *multiMatch = (friskMultiMatch *)calloc(1, sizeof(friskMultiMatch));
+    int patternCount = daSize(&patterns);
+    int totalBytes = 0;
+    int maxStates;
+    int *fail;
+    int *queue;
+    int queueHead = 0;
+    int queueTail = 0;
+    int i;
+
+    // Assign a column to every byte that shows up in a pattern
+    multiMatch->classCount = 1;
+    for(i = 0; i < patternCount; ++i)
+    {
+        const unsigned char *c = (const unsigned char *)patterns[i];
+        for(; *c; ++c)
+        {
+            unsigned char b = *c;
+            if(!caseSensitive)
+                b = (unsigned char)tolower(b);
+            if(!multiMatch->classes[b])
+            {
+                multiMatch->classes[b] = (unsigned char)multiMatch->classCount;
+                if(!caseSensitive)
+                    multiMatch->classes[toupper(b)] = (unsigned char)multiMatch->classCount;
+                multiMatch->classCount++;
+            }
+            totalBytes++;
+        }
+        if((int)strlen(patterns[i]) > multiMatch->maxPatternLength)
+            multiMatch->maxPatternLength = (int)strlen(patterns[i]);
+    }
+    multiMatch->patternCount = patternCount;
+
+    maxStates = totalBytes + 1;
+    multiMatch->transitions = (int *)malloc(sizeof(int) * maxStates * multiMatch->classCount);
+    multiMatch->patternAt = (int *)malloc(sizeof(int) * maxStates);
+    multiMatch->outputLink = (int *)malloc(sizeof(int) * maxStates);
+    multiMatch->depth = (int *)malloc(sizeof(int) * maxStates);
+    memset(multiMatch->transitions, 0xff, sizeof(int) * maxStates * multiMatch->classCount);
+    multiMatch->patternAt[0] = -1;
+    multiMatch->outputLink[0] = -1;
+    multiMatch->depth[0] = 0;
+    multiMatch->stateCount = 1;
+
+    // Build the trie
+    for(i = 0; i < patternCount; ++i)
+    {
+        const unsigned char *c = (const unsigned char *)patterns[i];
+        int state = 0;
+        if(!*c)
+            continue;
+        for(; *c; ++c)
+        {
+            int *next = &multiMatch->transitions[state * multiMatch->classCount + multiMatch->classes[*c]];
+            if(*next == -1)
+            {
+                int newState = multiMatch->stateCount++;
+                multiMatch->patternAt[newState] = -1;
+                multiMatch->outputLink[newState] = -1;
+                multiMatch->depth[newState] = multiMatch->depth[state] + 1;
+                *next = newState;
+            }
+            state = *next;
+        }
+        if(multiMatch->patternAt[state] == -1) // duplicates report the first index
+            multiMatch->patternAt[state] = i;
+    }
+
+    // Breadth-first pass to resolve failure links straight into the transition table
+    fail = (int *)calloc(multiMatch->stateCount, sizeof(int));
+    queue = (int *)malloc(sizeof(int) * multiMatch->stateCount);
+    for(i = 0; i < multiMatch->classCount; ++i)
+    {
+        int *next = &multiMatch->transitions[i];
+        if(*next == -1)
+        {
+            *next = 0;
+        }
+        else
+        {
+            fail[*next] = 0;
+            queue[queueTail++] = *next;
+        }
+    }
+    while(queueHead < queueTail)
+    {
+        int state = queue[queueHead++];
+        int *row = &multiMatch->transitions[state * multiMatch->classCount];
+        int *failRow = &multiMatch->transitions[fail[state] * multiMatch->classCount];
+        for(i = 0; i < multiMatch->classCount; ++i)
+        {
+            if(row[i] == -1)
+            {
+                row[i] = failRow[i];
+            }
+            else
+            {
+                int child = row[i];
+                int f = failRow[i];
+                fail[child] = f;
+                multiMatch->outputLink[child] = (multiMatch->patternAt[f] != -1) ? f : multiMatch->outputLink[f];
+                queue[queueTail++] = child;
+            }
+        }
+    }
+    free(queue);
+    free(fail);
+
+    multiMatch->transitions = (int *)realloc(multiMatch->transitions, sizeof(int) * multiMatch->stateCount * multiMatch->classCount);
+    return multiMatch;
+}
+
+void friskMultiMatchDestroy(friskMultiMatch * multiMatch)
+{
+    free(multiMatch->transitions);
+    free(multiMatch->patternAt);
+    free(multiMatch->outputLink);
+    free(multiMatch->depth);
+    free(multiMatch);
+}
+
+int friskMultiMatchFind(friskMultiMatch * multiMatch, const char * text, int len, int * matchPos, int * matchLen, int * pattern)
+{
+    const unsigned char *p = (const unsigned char *)text;
+    int bestStart = -1;
+    int bestState = -1;
+    int state = 0;
+    int i;
+
+    for(i = 0; i < len; ++i)
+    {
+        int output;
+        state = multiMatch->transitions[state * multiMatch->classCount + multiMatch->classes[p[i]]];
+
+        // The longest pattern ending here is also the one starting furthest left, so the rest of
+        // the output chain can't beat it.
+        output = (multiMatch->patternAt[state] != -1) ? state : multiMatch->outputLink[state];
+        if(output != -1)
+        {
+            int start = i - multiMatch->depth[output] + 1;
+            if((bestStart == -1) || (start <= bestStart))
+            {
+                bestStart = start;
+                bestState = output;
+            }
+        }
+
+        // Nothing that ends later can start at or before bestStart anymore (a later hit with the
+        // same start is longer, which is why ties above go to the newer one)
+        if((bestStart != -1) && ((i - bestStart + 1) >= multiMatch->maxPatternLength))
+            break;
+    }
+
+    if(bestStart == -1)
+        return 0;
+
+    *matchPos = bestStart;
+    *matchLen = multiMatch->depth[bestState];
+    *pattern = multiMatch->patternAt[bestState];
+    return 1;
+}
@@ -0,0 +1,30 @@
+#ifndef FRISKMULTIMATCH_H
+#define FRISKMULTIMATCH_H
+
+// ------------------------------------------------------------------------------------------------
+// Aho-Corasick automaton over a set of literal patterns. Every byte of the input is mapped through
+// a class table first (which also takes care of case folding), so the transition table only needs
+// one column per distinct pattern byte instead of all 256.
+
+typedef struct friskMultiMatch
+{
+    unsigned char classes[256]; // byte -> column in the transition table; 0 means "not in any pattern"
+    int classCount;
+    int stateCount;
+    int * transitions;          // stateCount * classCount, fully resolved (no failure links at scan time)
+    int * patternAt;            // pattern ending exactly at this state, or -1
+    int * outputLink;           // nearest suffix state with a pattern, or -1
+    int * depth;
+    int patternCount;
+    int maxPatternLength;
+} friskMultiMatch;
+
+// patterns is a dynArray of strings; empty patterns are ignored but keep their index.
+friskMultiMatch * friskMultiMatchCreate(char ** patterns, int caseSensitive);
+void friskMultiMatchDestroy(friskMultiMatch * multiMatch);
+
+// Finds the leftmost hit in text (longest wins on ties). Returns 1 on a hit and fills in the
+// offset, length and index of the pattern that matched.
+int friskMultiMatchFind(friskMultiMatch * multiMatch, const char * text, int len, int * matchPos, int * matchLen, int * pattern);
+
+#endif
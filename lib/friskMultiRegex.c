@@ -0,0 +1,235 @@
+#include "friskMultiRegex.h"
+
+#include "dynArray.h"
+#include "dynString.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+pcre_extra * friskSetMatchLimits(pcre_extra * extra, const pcre_extra * study, int matchLimit, int matchLimitRecursion)
+{
+    if(study)
+        *extra = *study;
+    else
+        memset(extra, 0, sizeof(pcre_extra));
+    if(matchLimit > 0)
+    {
+        extra->flags |= PCRE_EXTRA_MATCH_LIMIT;
+        extra->match_limit = matchLimit;
+    }
+    if(matchLimitRecursion > 0)
+    {
+        extra->flags |= PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+        extra->match_limit_recursion = matchLimitRecursion;
+    }
+    return extra;
+}
+
+// Subroutine calls, recursion and group conditionals point at groups by number (or at the whole
+// pattern), which wrapping and joining patterns would change. Errs on the side of finding one:
+// a false positive only costs a separate regex.
+static int refersToGroups(const char *pattern)
+{
+    const char *p = pattern;
+    while(*p)
+    {
+        if(p[0] == '\\')
+        {
+            if(p[1] == 'Q')
+            {
+                const char *end = strstr(p + 2, "\\E");
+                if(!end)
+                    return 0; // quoted to the end
+                p = end + 2;
+                continue;
+            }
+            if((p[1] == 'g') && ((p[2] == '<') || (p[2] == '\'')))
+                return 1; // \g<n> and \g'n' are subroutine calls (\g{n} is a backreference)
+            p += p[1] ? 2 : 1;
+            continue;
+        }
+        if((p[0] == '(') && (p[1] == '?'))
+        {
+            char c = p[2];
+            if(isdigit((unsigned char)c) || (c == '+') || (c == 'R') || (c == '&') || (c == '('))
+                return 1; // (?1) (?+1) (?R) (?&name) (?(1)...)
+            if((c == '-') && isdigit((unsigned char)p[3]))
+                return 1; // (?-1), not (?-i)
+            if((c == 'P') && (p[3] == '>'))
+                return 1; // (?P>name)
+        }
+        p++;
+    }
+    return 0;
+}
+
+// Whether pattern still compiles the way it's joined into the combined regex. Some valid patterns
+// don't: a leading (*CR) style verb is only allowed at the very start, and a (?x) comment runs
+// on past the closing parenthesis.
+static int compilesWrapped(const char *pattern, int options)
+{
+    char *wrapped = NULL;
+    const char *pcreError;
+    int erroffset;
+    pcre *regex;
+
+    dsPrintf(&wrapped, "(%s\\E)", pattern);
+    regex = pcre_compile(wrapped, options, &pcreError, &erroffset, NULL);
+    dsDestroy(&wrapped);
+    if(!regex)
+        return 0;
+    pcre_free(regex);
+    return 1;
+}
+
+// With combine 0, every pattern gets its own regex
+static friskMultiRegex * createMultiRegex(char ** patterns, int options, int matchLimit, int matchLimitRecursion, int combine, char ** error)
+{
+    friskMultiRegex *multiRegex = (friskMultiRegex *)calloc(1, sizeof(friskMultiRegex));
+    int patternCount = daSize(&patterns);
+    char *combinedString = NULL;
+    const char *pcreError;
+    int erroffset;
+    int i;
+
+    multiRegex->separatePatterns = (int *)malloc(sizeof(int) * patternCount);
+    multiRegex->groupPatterns = (int *)malloc(sizeof(int));
+    multiRegex->groupPatterns[0] = -1;
+    friskSetMatchLimits(&multiRegex->separateExtra, NULL, matchLimit, matchLimitRecursion);
+    if(options & PCRE_UTF8)
+        multiRegex->execOptions = PCRE_NO_UTF8_CHECK;
+
+    for(i = 0; i < patternCount; ++i)
+    {
+        int captureCount = 0;
+        int backrefMax = 0;
+        int g;
+        pcre *regex = pcre_compile(patterns[i], options, &pcreError, &erroffset, NULL);
+        if(!regex)
+        {
+            dsPrintf(error, "Match Regex Error (pattern %d): %s", i + 1, pcreError);
+            dsDestroy(&combinedString);
+            friskMultiRegexDestroy(multiRegex);
+            return NULL;
+        }
+        pcre_fullinfo(regex, NULL, PCRE_INFO_CAPTURECOUNT, &captureCount);
+        pcre_fullinfo(regex, NULL, PCRE_INFO_BACKREFMAX, &backrefMax);
+        if(!combine || (backrefMax > 0) || refersToGroups(patterns[i]) || !compilesWrapped(patterns[i], options))
+        {
+            // Room for every group: a conditional only sees a group as set if PCRE could record it
+            if((captureCount + 1) * 3 > multiRegex->separateOvectorSize)
+                multiRegex->separateOvectorSize = (captureCount + 1) * 3;
+            multiRegex->separatePatterns[daSize(&multiRegex->separate)] = i;
+            daPush(&multiRegex->separate, regex);
+            continue;
+        }
+        pcre_free(regex);
+
+        // The \E closes any \Q the pattern leaves open, and is ignored otherwise
+        if(combinedString)
+            dsConcat(&combinedString, "|");
+        dsConcat(&combinedString, "(");
+        dsConcat(&combinedString, patterns[i]);
+        dsConcat(&combinedString, "\\E)");
+
+        multiRegex->groupPatterns = (int *)realloc(multiRegex->groupPatterns, sizeof(int) * (multiRegex->groupCount + 2 + captureCount));
+        multiRegex->groupPatterns[++multiRegex->groupCount] = i;
+        for(g = 0; g < captureCount; ++g)
+            multiRegex->groupPatterns[++multiRegex->groupCount] = -1;
+    }
+
+    if(combinedString)
+    {
+        multiRegex->combined = pcre_compile(combinedString, options | PCRE_DUPNAMES, &pcreError, &erroffset, NULL);
+        dsDestroy(&combinedString);
+        if(!multiRegex->combined)
+        {
+            // Every pattern compiled on its own, so they can still be searched one at a time
+            friskMultiRegexDestroy(multiRegex);
+            return createMultiRegex(patterns, options, matchLimit, matchLimitRecursion, 0, error);
+        }
+        multiRegex->combinedStudy = pcre_study(multiRegex->combined, 0, &pcreError);
+        friskSetMatchLimits(&multiRegex->combinedExtra, multiRegex->combinedStudy, matchLimit, matchLimitRecursion);
+        multiRegex->ovectorSize = (multiRegex->groupCount + 1) * 3;
+        multiRegex->ovector = (int *)malloc(sizeof(int) * multiRegex->ovectorSize);
+    }
+    if(multiRegex->separateOvectorSize)
+        multiRegex->separateOvector = (int *)malloc(sizeof(int) * multiRegex->separateOvectorSize);
+    return multiRegex;
+}
+
+friskMultiRegex * friskMultiRegexCreate(char ** patterns, int options, int matchLimit, int matchLimitRecursion, char ** error)
+{
+    return createMultiRegex(patterns, options, matchLimit, matchLimitRecursion, 1, error);
+}
+
+static void destroyRegex(pcre *regex)
+{
+    pcre_free(regex);
+}
+
+void friskMultiRegexDestroy(friskMultiRegex * multiRegex)
+{
+    if(multiRegex->combinedStudy)
+        pcre_free_study(multiRegex->combinedStudy);
+    if(multiRegex->combined)
+        pcre_free(multiRegex->combined);
+    daDestroy(&multiRegex->separate, destroyRegex);
+    free(multiRegex->separatePatterns);
+    free(multiRegex->groupPatterns);
+    free(multiRegex->ovector);
+    free(multiRegex->separateOvector);
+    free(multiRegex);
+}
+
+int friskMultiRegexFind(friskMultiRegex * multiRegex, const char * text, int len, int start, int * matchPos, int * matchLen, int * pattern)
+{
+    int bestPattern = -1;
+    int i;
+
+    if(multiRegex->combined)
+    {
+        int *ovector = multiRegex->ovector;
+        int rc = pcre_exec(multiRegex->combined, &multiRegex->combinedExtra, text, len, start, multiRegex->execOptions, ovector, multiRegex->ovectorSize);
+        if((rc == PCRE_ERROR_MATCHLIMIT) || (rc == PCRE_ERROR_RECURSIONLIMIT) || (rc == PCRE_ERROR_JIT_STACKLIMIT))
+            return -1;
+        if(rc > 0)
+        {
+            int g;
+            for(g = 1; g < rc; ++g)
+            {
+                if((multiRegex->groupPatterns[g] != -1) && (ovector[g * 2] != -1))
+                {
+                    bestPattern = multiRegex->groupPatterns[g];
+                    break;
+                }
+            }
+            *matchPos = ovector[0];
+            *matchLen = ovector[1] - ovector[0];
+        }
+    }
+
+    for(i = 0; i < daSize(&multiRegex->separate); ++i)
+    {
+        int *ovector = multiRegex->separateOvector;
+        int candidate = multiRegex->separatePatterns[i];
+        int rc = pcre_exec(multiRegex->separate[i], &multiRegex->separateExtra, text, len, start, multiRegex->execOptions, ovector, multiRegex->separateOvectorSize);
+        if((rc == PCRE_ERROR_MATCHLIMIT) || (rc == PCRE_ERROR_RECURSIONLIMIT) || (rc == PCRE_ERROR_JIT_STACKLIMIT))
+            return -1;
+        if(rc >= 0)
+        {
+            if((bestPattern == -1) || (ovector[0] < *matchPos) || ((ovector[0] == *matchPos) && (candidate < bestPattern)))
+            {
+                bestPattern = candidate;
+                *matchPos = ovector[0];
+                *matchLen = ovector[1] - ovector[0];
+            }
+        }
+    }
+
+    if(bestPattern == -1)
+        return 0;
+
+    *pattern = bestPattern;
+    return 1;
+}
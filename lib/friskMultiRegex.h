@@ -0,0 +1,46 @@
+#ifndef FRISKMULTIREGEX_H
+#define FRISKMULTIREGEX_H
+
+#include <pcre.h>
+
+// ------------------------------------------------------------------------------------------------
+// Several regexes searched in one pass. Every pattern is wrapped in its own capture group and the
+// lot is compiled as a single alternation, so a hit is attributed by looking at which of those
+// outer groups is set. Patterns with backreferences, subroutine calls, recursion or group
+// conditionals can't be renumbered safely, so those are kept as separate regexes and raced against
+// the combined one, as are patterns that don't compile once wrapped (a leading (*CR) style verb,
+// a (?x) comment that would swallow the closing parenthesis).
+
+typedef struct friskMultiRegex
+{
+    pcre * combined;
+    pcre_extra * combinedStudy;
+    pcre_extra combinedExtra;  // study data plus match limits; what pcre_exec actually gets
+    pcre_extra separateExtra;  // just the match limits
+    int * groupPatterns;   // capture group number -> pattern index, -1 for a pattern's own groups
+    int groupCount;
+    int * ovector;
+    int ovectorSize;
+    int execOptions;       // PCRE_NO_UTF8_CHECK with PCRE_UTF8: the caller validates whole files up front
+
+    pcre ** separate;      // dynArray
+    int * separatePatterns;
+    int * separateOvector; // big enough for any of them
+    int separateOvectorSize;
+} friskMultiRegex;
+
+// patterns is a dynArray of strings. A limit of 0 keeps PCRE's default. With PCRE_UTF8 in
+// options, text given to friskMultiRegexFind() must already be valid UTF-8. On failure returns
+// NULL and fills in error.
+friskMultiRegex * friskMultiRegexCreate(char ** patterns, int options, int matchLimit, int matchLimitRecursion, char ** error);
+void friskMultiRegexDestroy(friskMultiRegex * multiRegex);
+
+// Finds the leftmost hit in text at or after start (earlier patterns win ties). Returns 1 on a
+// hit and fills in the offset, length and index of the pattern that matched, 0 on no hit, or
+// -1 if PCRE gave up because of the match limits.
+int friskMultiRegexFind(friskMultiRegex * multiRegex, const char * text, int len, int start, int * matchPos, int * matchLen, int * pattern);
+
+// Fills in extra with whatever study gave us (may be NULL) plus the match limits.
+pcre_extra * friskSetMatchLimits(pcre_extra * extra, const pcre_extra * study, int matchLimit, int matchLimitRecursion);
+
+#endif
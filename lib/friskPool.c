@@ -0,0 +1,231 @@
+#include "friskPool.h"
+
+#include <stdlib.h>
+
+typedef struct poolWorker
+{
+    friskPool *pool;
+    int index;
+    int node;   // which queue it takes from first
+} poolWorker;
+
+// ------------------------------------------------------------------------------------------------
+
+static void queuePush(friskPoolQueue *queue, void *job, int *done)
+{
+    if(queue->count == queue->capacity)
+    {
+        int newCapacity = queue->capacity ? queue->capacity * 2 : 64;
+        friskPoolItem *items = (friskPoolItem *)calloc(newCapacity, sizeof(friskPoolItem));
+        int i;
+        for(i = 0; i < queue->count; ++i)
+            items[i] = queue->items[(queue->head + i) % queue->capacity];
+        free(queue->items);
+        queue->items = items;
+        queue->head = 0;
+        queue->capacity = newCapacity;
+    }
+    queue->items[(queue->head + queue->count) % queue->capacity].job = job;
+    queue->items[(queue->head + queue->count) % queue->capacity].done = done;
+    queue->count++;
+}
+
+// Own node's queue first, then the others in order
+static int takeJob(friskPool *pool, int node, friskPoolItem *item)
+{
+    int i;
+    for(i = 0; i < pool->queueCount; ++i)
+    {
+        friskPoolQueue *queue = &pool->queues[(node + i) % pool->queueCount];
+        if(queue->count)
+        {
+            *item = queue->items[queue->head];
+            queue->head = (queue->head + 1) % queue->capacity;
+            queue->count--;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void placeWorker(poolWorker *worker)
+{
+    friskPool *pool = worker->pool;
+    switch(pool->policy)
+    {
+        case FTP_PIN_CORES:
+        {
+            // Deal the cores out node by node so neighbouring workers share a node
+            int skip = worker->index;
+            int node = 0;
+            int total = 0;
+            int i;
+            for(i = 0; i < pool->nodeCount; ++i)
+                total += pool->nodeSizes[i];
+            skip %= total;
+            while(skip >= pool->nodeSizes[node])
+                skip -= pool->nodeSizes[node++];
+            friskThreadPin(&pool->nodeCpus[node][skip], 1);
+            break;
+        }
+        case FTP_NUMA:
+            friskThreadPin(pool->nodeCpus[worker->node], pool->nodeSizes[worker->node]);
+            break;
+    }
+}
+
+static void workerMain(void *userData)
+{
+    poolWorker *worker = (poolWorker *)userData;
+    friskPool *pool = worker->pool;
+    friskPoolItem item;
+    void *state;
+
+    placeWorker(worker);
+    state = pool->workerCreate ? pool->workerCreate(pool->userData, worker->index, worker->node) : NULL;
+
+    friskMutexLock(pool->lock);
+    for(;;)
+    {
+        if(!takeJob(pool, worker->node, &item))
+        {
+            if(pool->quitting)
+                break;
+            friskConditionWait(pool->workReady, pool->lock);
+            continue;
+        }
+        friskMutexUnlock(pool->lock);
+
+        pool->workerRun(state, item.job);
+
+        friskMutexLock(pool->lock);
+        if(item.done)
+        {
+            *item.done = 1;
+            friskConditionBroadcast(pool->jobDone);
+        }
+    }
+    friskMutexUnlock(pool->lock);
+
+    if(pool->workerDestroy)
+        pool->workerDestroy(state);
+    free(worker);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+int friskPoolThreadCount(int threads)
+{
+    if(threads <= 0)
+    {
+        int *cpus;
+        threads = friskCpuList(&cpus);
+        free(cpus);
+        if(threads > FRISK_POOL_DEFAULT_MAX_THREADS)
+            threads = FRISK_POOL_DEFAULT_MAX_THREADS;
+    }
+    return threads;
+}
+
+friskPool * friskPoolCreate(int threads, int policy, friskWorkerCreateFunc workerCreate, friskWorkerRunFunc workerRun, friskWorkerDestroyFunc workerDestroy, void * userData)
+{
+    friskPool *pool = (friskPool *)calloc(1, sizeof(friskPool));
+    int started = 0;
+    int i;
+
+    pool->threadCount = friskPoolThreadCount(threads);
+    pool->policy = policy;
+    pool->workerCreate = workerCreate;
+    pool->workerRun = workerRun;
+    pool->workerDestroy = workerDestroy;
+    pool->userData = userData;
+    pool->lock = friskMutexCreate();
+    pool->workReady = friskConditionCreate();
+    pool->jobDone = friskConditionCreate();
+
+    pool->nodeCount = friskNumaNodes(&pool->nodeCpus, &pool->nodeSizes);
+    pool->queueCount = (policy == FTP_NUMA) ? pool->nodeCount : 1;
+    pool->queues = (friskPoolQueue *)calloc(pool->queueCount, sizeof(friskPoolQueue));
+
+    pool->threads = (friskThread **)calloc(pool->threadCount, sizeof(friskThread *));
+    for(i = 0; i < pool->threadCount; ++i)
+    {
+        poolWorker *worker = (poolWorker *)calloc(1, sizeof(poolWorker));
+        worker->pool = pool;
+        worker->index = i;
+        worker->node = i % pool->queueCount;
+        pool->threads[started] = friskThreadStart(workerMain, worker);
+        if(pool->threads[started])
+            started++;
+        else
+            free(worker);
+    }
+    pool->threadCount = started;
+    if(!started)
+    {
+        friskPoolDestroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void friskPoolDestroy(friskPool * pool)
+{
+    int i;
+    if(!pool)
+        return;
+
+    friskMutexLock(pool->lock);
+    pool->quitting = 1;
+    friskConditionBroadcast(pool->workReady);
+    friskMutexUnlock(pool->lock);
+    for(i = 0; i < pool->threadCount; ++i)
+        friskThreadJoin(pool->threads[i]);
+
+    for(i = 0; i < pool->queueCount; ++i)
+        free(pool->queues[i].items);
+    for(i = 0; i < pool->nodeCount; ++i)
+        free(pool->nodeCpus[i]);
+    free(pool->nodeCpus);
+    free(pool->nodeSizes);
+    free(pool->queues);
+    free(pool->threads);
+    friskConditionDestroy(pool->jobDone);
+    friskConditionDestroy(pool->workReady);
+    friskMutexDestroy(pool->lock);
+    free(pool);
+}
+
+int friskPoolNodeCount(friskPool * pool)
+{
+    return pool->queueCount;
+}
+
+void friskPoolSubmit(friskPool * pool, int node, void * job, int * done)
+{
+    if(node < 0)
+        node = 0;
+    friskMutexLock(pool->lock);
+    if(done)
+        *done = 0;
+    queuePush(&pool->queues[node % pool->queueCount], job, done);
+    friskConditionSignal(pool->workReady);
+    friskMutexUnlock(pool->lock);
+}
+
+int friskPoolIsDone(friskPool * pool, int * done)
+{
+    int ret;
+    friskMutexLock(pool->lock);
+    ret = *done;
+    friskMutexUnlock(pool->lock);
+    return ret;
+}
+
+void friskPoolWait(friskPool * pool, int * done)
+{
+    friskMutexLock(pool->lock);
+    while(!*done)
+        friskConditionWait(pool->jobDone, pool->lock);
+    friskMutexUnlock(pool->lock);
+}
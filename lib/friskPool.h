@@ -0,0 +1,76 @@
+#ifndef FRISKPOOL_H
+#define FRISKPOOL_H
+
+#include "friskThread.h"
+
+// ------------------------------------------------------------------------------------------------
+// A fixed set of worker threads running jobs. Each worker gets its own state from workerCreate()
+// (called on the worker thread itself, after it has been placed, so anything it allocates lands
+// in that worker's memory), which is handed to every job it runs. Jobs are queued per NUMA node
+// under FTP_NUMA: a worker takes from its own node's queue first and only reaches across to
+// another node's when its own is empty. Other policies have a single queue.
+
+typedef enum friskThreadPolicy
+{
+    FTP_FLOAT = 0,  // leave placement to the OS
+    FTP_PIN_CORES,  // pin each worker to its own core, round robin over the usable cores
+    FTP_NUMA        // spread workers evenly over the NUMA nodes, pinned to their node's cores
+} friskThreadPolicy;
+
+// Upper bound for the automatic thread count; beyond this a search is waiting on the disk anyway
+#define FRISK_POOL_DEFAULT_MAX_THREADS (16)
+
+typedef void * (*friskWorkerCreateFunc)(void * userData, int worker, int node);
+typedef void (*friskWorkerRunFunc)(void * worker, void * job);
+typedef void (*friskWorkerDestroyFunc)(void * worker);
+
+typedef struct friskPoolItem
+{
+    void * job;
+    int * done;           // set (under the pool's lock) once the job has run; may be NULL
+} friskPoolItem;
+
+typedef struct friskPoolQueue
+{
+    friskPoolItem * items; // ring
+    int head;
+    int count;
+    int capacity;
+} friskPoolQueue;
+
+typedef struct friskPool
+{
+    friskThread ** threads;
+    int threadCount;
+    int policy;
+    friskPoolQueue * queues; // one per node under FTP_NUMA, else just one
+    int queueCount;
+    int ** nodeCpus;
+    int * nodeSizes;
+    int nodeCount;
+    friskMutex * lock;
+    friskCondition * workReady;
+    friskCondition * jobDone;
+    int quitting;
+    friskWorkerCreateFunc workerCreate;
+    friskWorkerRunFunc workerRun;
+    friskWorkerDestroyFunc workerDestroy;
+    void * userData;
+} friskPool;
+
+// Resolves a requested thread count: 0 (or less) means one per usable core, capped at
+// FRISK_POOL_DEFAULT_MAX_THREADS.
+int friskPoolThreadCount(int threads);
+
+// Returns NULL if no worker thread could be started
+friskPool * friskPoolCreate(int threads, int policy, friskWorkerCreateFunc workerCreate, friskWorkerRunFunc workerRun, friskWorkerDestroyFunc workerDestroy, void * userData);
+void friskPoolDestroy(friskPool * pool); // runs whatever is still queued, then joins
+
+// How many queues jobs can be spread over; Submit() takes node modulo this
+int friskPoolNodeCount(friskPool * pool);
+
+void friskPoolSubmit(friskPool * pool, int node, void * job, int * done);
+int friskPoolIsDone(friskPool * pool, int * done);
+void friskPoolWait(friskPool * pool, int * done);
+
+#endif
@@ -0,0 +1,496 @@
+#ifdef FRISK_PLATFORM_LINUX
+#define _GNU_SOURCE
+#endif
+
+#include "friskReader.h"
+#include "friskBufferPool.h"
+#include "friskContext.h"
+
+#include "dynString.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FRISK_PLATFORM_LINUX
+#include <fcntl.h>
+#endif
+
+#ifdef FRISK_HAVE_IO_URING
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// Blocking reads on a pool
+
+static void readBlocking(void *worker, void *job)
+{
+    friskReadRequest *read = (friskReadRequest *)job;
+    friskReader *reader = (friskReader *)worker;
+    char *contents = NULL;
+    int size = 0;
+    int capacity = 0;
+    if(!friskReadPooledFile(reader->buffers, read->filename, &contents, &size, &capacity, reader->maxSizeKb, reader->ioPolicy))
+    {
+        contents = NULL;
+        size = 0;
+        capacity = 0;
+    }
+    reader->onRead(reader->userData, read->request, contents, size, capacity);
+    dsDestroy(&read->filename);
+    free(read);
+}
+
+static void *createBlockingReader(void *userData, int worker, int node)
+{
+    (void)worker;
+    (void)node;
+    return userData;
+}
+
+#ifdef FRISK_HAVE_IO_URING
+
+// ------------------------------------------------------------------------------------------------
+// io_uring, driven with the raw syscalls so there's nothing extra to link
+
+// What a completion was for, kept in the low bits of its user_data
+#define OP_OPEN (0)
+#define OP_STAT (1)
+#define OP_READ (2)
+#define OP_MASK (3)
+
+typedef struct friskUring
+{
+    int fd;
+    void *sqRing;
+    void *cqRing;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned sqEntries;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+    unsigned toSubmit;
+} friskUring;
+
+static void ringDestroy(friskUring *ring)
+{
+    if(ring->sqes)
+        munmap(ring->sqes, ring->sqesSize);
+    if(ring->cqRing && (ring->cqRing != ring->sqRing))
+        munmap(ring->cqRing, ring->cqRingSize);
+    if(ring->sqRing)
+        munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+    free(ring);
+}
+
+// NULL if the kernel doesn't have io_uring, won't let us use it (seccomp, sysctl), or predates
+// the openat/statx/read opcodes (5.6, the same release as IORING_FEAT_RW_CUR_POS)
+static friskUring *ringCreate(unsigned entries)
+{
+    struct io_uring_params params;
+    friskUring *ring;
+    int fd;
+
+    memset(&params, 0, sizeof(params));
+    fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if(fd < 0)
+        return NULL;
+    ring = (friskUring *)calloc(1, sizeof(friskUring));
+    ring->fd = fd;
+    if(!(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        ringDestroy(ring);
+        return NULL;
+    }
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(ring->cqRingSize > ring->sqRingSize)
+            ring->sqRingSize = ring->cqRingSize;
+        ring->cqRingSize = ring->sqRingSize;
+    }
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(ring->sqRing == MAP_FAILED)
+    {
+        ring->sqRing = NULL;
+        ringDestroy(ring);
+        return NULL;
+    }
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->cqRing = ring->sqRing;
+    }
+    else
+    {
+        ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(ring->cqRing == MAP_FAILED)
+        {
+            ring->cqRing = NULL;
+            ringDestroy(ring);
+            return NULL;
+        }
+    }
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        ringDestroy(ring);
+        return NULL;
+    }
+
+    ring->sqHead = (unsigned *)((char *)ring->sqRing + params.sq_off.head);
+    ring->sqTail = (unsigned *)((char *)ring->sqRing + params.sq_off.tail);
+    ring->sqMask = (unsigned *)((char *)ring->sqRing + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)((char *)ring->sqRing + params.sq_off.array);
+    ring->sqEntries = params.sq_entries;
+    ring->cqHead = (unsigned *)((char *)ring->cqRing + params.cq_off.head);
+    ring->cqTail = (unsigned *)((char *)ring->cqRing + params.cq_off.tail);
+    ring->cqMask = (unsigned *)((char *)ring->cqRing + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((char *)ring->cqRing + params.cq_off.cqes);
+    return ring;
+}
+
+// Every started file has at most two requests outstanding, and the ring has room for two per
+// file, so there's always a free entry
+static struct io_uring_sqe *ringQueue(friskUring *ring, int op, friskReadRequest *read)
+{
+    unsigned tail = *ring->sqTail;
+    unsigned index = tail & *ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = (unsigned char)op;
+    sqe->user_data = (unsigned long long)(size_t)read;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->toSubmit++;
+    read->waiting++;
+    return sqe;
+}
+
+static void queueOpen(friskUring *ring, friskReadRequest *read)
+{
+    struct io_uring_sqe *sqe = ringQueue(ring, IORING_OP_OPENAT, read);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (unsigned long long)(size_t)read->filename;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data |= OP_OPEN;
+}
+
+static void queueStat(friskUring *ring, friskReadRequest *read)
+{
+    struct io_uring_sqe *sqe = ringQueue(ring, IORING_OP_STATX, read);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (unsigned long long)(size_t)read->filename;
+    sqe->len = STATX_SIZE;
+    sqe->off = (unsigned long long)(size_t)read->stat;
+    sqe->user_data |= OP_STAT;
+}
+
+static void queueRead(friskUring *ring, friskReadRequest *read)
+{
+    struct io_uring_sqe *sqe = ringQueue(ring, IORING_OP_READ, read);
+    sqe->fd = read->fd;
+    sqe->addr = (unsigned long long)(size_t)(read->contents + read->got);
+    sqe->len = (unsigned)(read->size - read->got);
+    sqe->off = (unsigned long long)read->got;
+    sqe->user_data |= OP_READ;
+}
+
+// Hands the file over (or NULL if it failed) and forgets about it
+static void finishRead(friskReader *reader, friskReadRequest *read)
+{
+    char *contents = NULL;
+    int size = 0;
+    int capacity = 0;
+    if(read->fd >= 0)
+    {
+        if(read->got)
+            friskAdviseDone(read->fd, read->size, reader->ioPolicy);
+        close(read->fd);
+    }
+    if(!read->failed && read->contents)
+    {
+        contents = read->contents;
+        size = (int)read->size;
+        capacity = read->capacity;
+        contents[size] = 0;
+    }
+    else
+    {
+        friskBufferPoolPut(reader->buffers, read->contents, read->capacity);
+    }
+    reader->onRead(reader->userData, read->request, contents, size, capacity);
+    dsDestroy(&read->filename);
+    free(read->stat);
+    free(read);
+    reader->active--;
+}
+
+// Opening and sizing the file are both in flight at once; reading starts once both are back
+static void completeRead(friskReader *reader, friskReadRequest *read, int op, int res)
+{
+    read->waiting--;
+    switch(op)
+    {
+        case OP_OPEN:
+            if(res >= 0)
+                read->fd = res;
+            else
+                read->failed = 1;
+            break;
+        case OP_STAT:
+            if(res >= 0)
+                read->size = (long long)((struct statx *)read->stat)->stx_size;
+            else
+                read->failed = 1;
+            break;
+        case OP_READ:
+            // A file that shrank underneath us is a failed read, same as friskReadEntireFile()
+            if(res <= 0)
+                read->failed = 1;
+            else
+                read->got += res;
+            break;
+    }
+    if(read->waiting)
+        return;
+
+    if(!read->failed && !read->contents)
+    {
+        if((read->size <= 0) || (read->size >= 0x7fffffff) || (reader->maxSizeKb && ((unsigned long long)(read->size / 1024) > reader->maxSizeKb)))
+        {
+            read->failed = 1;
+        }
+        else
+        {
+            read->contents = friskBufferPoolGet(reader->buffers, (int)read->size + 1, &read->capacity);
+            friskAdviseRead(read->fd, reader->ioPolicy);
+            queueRead(reader->ring, read);
+            return;
+        }
+    }
+    if(!read->failed && (read->got < read->size))
+    {
+        queueRead(reader->ring, read);
+        return;
+    }
+    finishRead(reader, read);
+}
+
+static void reapCompletions(friskReader *reader)
+{
+    friskUring *ring = reader->ring;
+    unsigned head = *ring->cqHead;
+    while(head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+    {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+        friskReadRequest *read = (friskReadRequest *)(size_t)(cqe->user_data & ~(unsigned long long)OP_MASK);
+        int op = (int)(cqe->user_data & OP_MASK);
+        int res = cqe->res;
+        head++;
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+        completeRead(reader, read, op, res);
+    }
+}
+
+// io_uring_enter() failed outright, so it took none of the queued entries. The kernel only reads
+// the submission queue in there, so they can be taken back off it and failed, which finishes
+// every file that has nothing else in flight.
+static void failUnsubmitted(friskReader *reader, int error)
+{
+    friskUring *ring = reader->ring;
+    unsigned tail = *ring->sqTail;
+    unsigned i;
+
+    __atomic_store_n(ring->sqTail, tail - ring->toSubmit, __ATOMIC_RELEASE);
+    for(i = tail - ring->toSubmit; i != tail; ++i)
+    {
+        struct io_uring_sqe *sqe = &ring->sqes[ring->sqArray[i & *ring->sqMask]];
+        friskReadRequest *read = (friskReadRequest *)(size_t)(sqe->user_data & ~(unsigned long long)OP_MASK);
+        completeRead(reader, read, (int)(sqe->user_data & OP_MASK), -error);
+    }
+    ring->toSubmit = 0;
+}
+
+static void ringMain(void *userData)
+{
+    friskReader *reader = (friskReader *)userData;
+    friskUring *ring = reader->ring;
+
+    friskMutexLock(reader->lock);
+    for(;;)
+    {
+        while(reader->queued && (reader->active < reader->depth))
+        {
+            friskReadRequest *read = reader->queued;
+            reader->queued = read->next;
+            if(!reader->queued)
+                reader->queuedTail = NULL;
+            reader->active++;
+            queueOpen(ring, read);
+            queueStat(ring, read);
+        }
+        if(!reader->active)
+        {
+            if(reader->quitting)
+                break;
+            friskConditionWait(reader->wake, reader->lock);
+            continue;
+        }
+        friskMutexUnlock(reader->lock);
+
+        // Submit whatever is queued and sleep until at least one thing is back. EBUSY and EAGAIN
+        // mean the completion queue (or the kernel) needs draining first, so reap and come back.
+        for(;;)
+        {
+            int rc = (int)syscall(__NR_io_uring_enter, ring->fd, ring->toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            if(rc >= 0)
+            {
+                ring->toSubmit -= (unsigned)rc;
+                break;
+            }
+            if(errno == EINTR)
+                continue;
+            if((errno != EAGAIN) && (errno != EBUSY))
+                failUnsubmitted(reader, errno);
+            break;
+        }
+        reapCompletions(reader);
+
+        friskMutexLock(reader->lock);
+    }
+    friskMutexUnlock(reader->lock);
+}
+
+#endif
+
+// ------------------------------------------------------------------------------------------------
+
+friskReader * friskReaderCreate(int depth, unsigned long long maxSizeKb, int ioPolicy, struct friskBufferPool * buffers, friskReadFunc onRead, void * userData)
+{
+    friskReader *reader = (friskReader *)calloc(1, sizeof(friskReader));
+    reader->depth = (depth > 0) ? depth : FRISK_READER_DEFAULT_DEPTH;
+    reader->maxSizeKb = maxSizeKb;
+    reader->ioPolicy = ioPolicy;
+    reader->buffers = buffers;
+    reader->onRead = onRead;
+    reader->userData = userData;
+
+#ifdef FRISK_HAVE_IO_URING
+    reader->ring = ringCreate((unsigned)reader->depth * 2);
+    if(reader->ring)
+    {
+        reader->lock = friskMutexCreate();
+        reader->wake = friskConditionCreate();
+        reader->thread = friskThreadStart(ringMain, reader);
+        if(reader->thread)
+            return reader;
+        friskConditionDestroy(reader->wake);
+        friskMutexDestroy(reader->lock);
+        ringDestroy(reader->ring);
+        reader->ring = NULL;
+    }
+#endif
+
+    reader->pool = friskPoolCreate((reader->depth < FRISK_READER_MAX_THREADS) ? reader->depth : FRISK_READER_MAX_THREADS, FTP_FLOAT, createBlockingReader, readBlocking, NULL, reader);
+    if(!reader->pool)
+    {
+        free(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+void friskReaderDestroy(friskReader * reader)
+{
+    if(!reader)
+        return;
+    if(reader->pool)
+    {
+        friskPoolDestroy(reader->pool);
+        free(reader);
+        return;
+    }
+
+#ifdef FRISK_HAVE_IO_URING
+    friskMutexLock(reader->lock);
+    reader->quitting = 1;
+    friskConditionSignal(reader->wake);
+    friskMutexUnlock(reader->lock);
+    friskThreadJoin(reader->thread);
+    friskConditionDestroy(reader->wake);
+    friskMutexDestroy(reader->lock);
+    ringDestroy(reader->ring);
+#endif
+    free(reader);
+}
+
+void friskReaderSubmit(friskReader * reader, const char * filename, void * request)
+{
+    friskReadRequest *read = (friskReadRequest *)calloc(1, sizeof(friskReadRequest));
+    read->filename = dsDup(filename);
+    read->request = request;
+    read->fd = -1;
+    if(reader->pool)
+    {
+        friskPoolSubmit(reader->pool, 0, read, NULL);
+        return;
+    }
+
+#ifdef FRISK_HAVE_IO_URING
+    read->stat = calloc(1, sizeof(struct statx));
+    friskMutexLock(reader->lock);
+    if(reader->queuedTail)
+        reader->queuedTail->next = read;
+    else
+        reader->queued = read;
+    reader->queuedTail = read;
+    friskConditionSignal(reader->wake);
+    friskMutexUnlock(reader->lock);
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void friskAdviseRead(int fd, int ioPolicy)
+{
+#ifdef FRISK_PLATFORM_LINUX
+    if(ioPolicy & FIO_READAHEAD)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    }
+#else
+    (void)fd;
+    (void)ioPolicy;
+#endif
+}
+
+void friskAdviseDone(int fd, long long size, int ioPolicy)
+{
+#ifdef FRISK_PLATFORM_LINUX
+    // The pages are clean, so they go straight away instead of pushing out everyone else's
+    if((ioPolicy & FIO_DONT_CACHE) && (size >= FRISK_DONT_CACHE_SIZE))
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+    (void)fd;
+    (void)size;
+    (void)ioPolicy;
+#endif
+}
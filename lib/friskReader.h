@@ -0,0 +1,70 @@
+#ifndef FRISKREADER_H
+#define FRISKREADER_H
+
+#include "friskPool.h"
+
+// ------------------------------------------------------------------------------------------------
+// The reader stage of a threaded search: whole files are read ahead of the threads searching them,
+// with many reads outstanding at once, so a cold tree (or a network mount) goes as fast as the
+// storage can take requests in parallel instead of one open/read/close at a time. On Linux, if
+// the kernel lets us, a single thread keeps the openat, statx and read requests in flight on an
+// io_uring. Anywhere else, or if io_uring can't be set up, a handful of threads read with blocking
+// reads.
+
+// Files read ahead by default
+#define FRISK_READER_DEFAULT_DEPTH (64)
+
+// Threads doing blocking reads when there's no io_uring
+#define FRISK_READER_MAX_THREADS (16)
+
+// Called on a reader thread as each file finishes, in no particular order. contents is NUL
+// terminated, from the reader's buffers (capacity bytes of room), and now belongs to the callee;
+// it's NULL if the file couldn't be read, was empty, or was bigger than maxSizeKb.
+typedef void (*friskReadFunc)(void * userData, void * request, char * contents, int size, int capacity);
+
+typedef struct friskReadRequest
+{
+    char * filename;
+    void * request;
+    int fd;
+    long long size;
+    int got;          // bytes read so far
+    int waiting;      // completions still to come before the next step
+    int failed;
+    char * contents;
+    int capacity;
+    void * stat;      // struct statx, for the io_uring backend
+    struct friskReadRequest * next;
+} friskReadRequest;
+
+typedef struct friskReader
+{
+    unsigned long long maxSizeKb; // 0 for no limit
+    int ioPolicy;                 // friskIoFlag
+    int depth;
+    struct friskBufferPool * buffers; // contents come from here (shared, or NULL to malloc)
+    friskReadFunc onRead;
+    void * userData;
+
+    friskPool * pool;          // blocking reads, when there's no ring
+    struct friskUring * ring;
+    friskThread * thread;      // the ring's
+    friskMutex * lock;
+    friskCondition * wake;
+    friskReadRequest * queued; // submitted but not started, oldest first (under lock)
+    friskReadRequest * queuedTail;
+    int active;                // started and not finished (ring thread only)
+    int quitting;
+} friskReader;
+
+// depth of 0 means FRISK_READER_DEFAULT_DEPTH
+friskReader * friskReaderCreate(int depth, unsigned long long maxSizeKb, int ioPolicy, struct friskBufferPool * buffers, friskReadFunc onRead, void * userData);
+void friskReaderDestroy(friskReader * reader); // reads everything still queued first
+void friskReaderSubmit(friskReader * reader, const char * filename, void * request);
+
+// The friskIoFlag hints for a file descriptor about to be read from start to finish, and for one
+// that has just been read (size bytes). No-ops where there's no posix_fadvise().
+void friskAdviseRead(int fd, int ioPolicy);
+void friskAdviseDone(int fd, long long size, int ioPolicy);
+
+#endif
@@ -0,0 +1,150 @@
+#include "friskRegexCache.h"
+#include "friskThread.h"
+
+#include "dynString.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ------------------------------------------------------------------------------------------------
+
+static void destroyCachedRegex(friskCachedRegex *cached)
+{
+    if(cached->study)
+        pcre_free_study(cached->study);
+    pcre_free(cached->regex);
+    dsDestroy(&cached->pattern);
+    free(cached);
+}
+
+static void unlinkRegex(friskRegexCache *cache, friskCachedRegex *cached)
+{
+    if(cached->prev)
+        cached->prev->next = cached->next;
+    else
+        cache->head = cached->next;
+    if(cached->next)
+        cached->next->prev = cached->prev;
+    else
+        cache->tail = cached->prev;
+    cached->prev = NULL;
+    cached->next = NULL;
+    cache->count--;
+}
+
+static void pushFront(friskRegexCache *cache, friskCachedRegex *cached)
+{
+    cached->prev = NULL;
+    cached->next = cache->head;
+    if(cache->head)
+        cache->head->prev = cached;
+    else
+        cache->tail = cached;
+    cache->head = cached;
+    cache->count++;
+}
+
+// Drops the cache's reference; anyone still using it frees it when they put it back
+static void evict(friskRegexCache *cache, friskCachedRegex *cached)
+{
+    unlinkRegex(cache, cached);
+    if(--cached->refs == 0)
+        destroyCachedRegex(cached);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+friskRegexCache * friskRegexCacheCreate(int capacity)
+{
+    friskRegexCache *cache = (friskRegexCache *)calloc(1, sizeof(friskRegexCache));
+    cache->capacity = (capacity > 0) ? capacity : 1;
+    cache->refs = 1;
+    cache->lock = friskMutexCreate();
+    return cache;
+}
+
+friskRegexCache * friskRegexCacheRetain(friskRegexCache * cache)
+{
+    friskMutexLock(cache->lock);
+    cache->refs++;
+    friskMutexUnlock(cache->lock);
+    return cache;
+}
+
+void friskRegexCacheRelease(friskRegexCache * cache)
+{
+    int refs;
+    if(!cache)
+        return;
+    friskMutexLock(cache->lock);
+    refs = --cache->refs;
+    friskMutexUnlock(cache->lock);
+    if(refs > 0)
+        return;
+
+    while(cache->head)
+        evict(cache, cache->head);
+    friskMutexDestroy(cache->lock);
+    free(cache);
+}
+
+friskCachedRegex * friskRegexCacheGet(friskRegexCache * cache, const char * pattern, int options, const char ** error)
+{
+    friskCachedRegex *cached;
+    pcre *regex;
+    int erroffset;
+
+    friskMutexLock(cache->lock);
+    for(cached = cache->head; cached; cached = cached->next)
+    {
+        if((cached->options == options) && !strcmp(cached->pattern, pattern))
+        {
+            if(cached != cache->head)
+            {
+                unlinkRegex(cache, cached);
+                pushFront(cache, cached);
+            }
+            cached->refs++;
+            cache->hits++;
+            friskMutexUnlock(cache->lock);
+            return cached;
+        }
+    }
+    cache->misses++;
+    friskMutexUnlock(cache->lock);
+
+    // Compile outside the lock; if another thread races us to the same pattern, both get cached
+    // and the older one just ages out
+    regex = pcre_compile(pattern, options, error, &erroffset, NULL);
+    if(!regex)
+        return NULL;
+    cached = (friskCachedRegex *)calloc(1, sizeof(friskCachedRegex));
+    cached->pattern = dsDup(pattern);
+    cached->options = options;
+    cached->regex = regex;
+#ifdef PCRE_STUDY_JIT_COMPILE
+    cached->study = pcre_study(regex, PCRE_STUDY_JIT_COMPILE, error);
+#else
+    cached->study = pcre_study(regex, 0, error);
+#endif
+    cached->refs = 2;
+
+    friskMutexLock(cache->lock);
+    pushFront(cache, cached);
+    while(cache->count > cache->capacity)
+        evict(cache, cache->tail);
+    friskMutexUnlock(cache->lock);
+    return cached;
+}
+
+void friskRegexCachePut(friskRegexCache * cache, friskCachedRegex * cached)
+{
+    int refs;
+    if(!cached)
+        return;
+    friskMutexLock(cache->lock);
+    refs = --cached->refs;
+    friskMutexUnlock(cache->lock);
+    if(refs == 0)
+        destroyCachedRegex(cached);
+}
@@ -0,0 +1,49 @@
+#ifndef FRISKREGEXCACHE_H
+#define FRISKREGEXCACHE_H
+
+#include <pcre.h>
+
+// ------------------------------------------------------------------------------------------------
+// Compiled (and studied, and JIT compiled when PCRE has it) regexes, kept by (pattern, options) in
+// least recently used order so rerunning a search doesn't pay for any of that again. Every context
+// gets one, and contexts can share one by retaining it. Lookups lock, so threads can share a cache
+// too. A regex that's been handed out is only freed once it's put back, even if it's been evicted
+// in the meantime, but it has to be put back before the cache's last reference goes.
+
+// How many regexes a context's own cache keeps
+#define FRISK_REGEX_CACHE_SIZE (64)
+
+typedef struct friskCachedRegex
+{
+    char * pattern;
+    int options;
+    pcre * regex;
+    pcre_extra * study;   // may be NULL
+    int refs;             // the cache's own (while it's listed) plus one per Get()
+    struct friskCachedRegex * prev; // towards the most recently used
+    struct friskCachedRegex * next;
+} friskCachedRegex;
+
+typedef struct friskRegexCache
+{
+    friskCachedRegex * head; // most recently used
+    friskCachedRegex * tail;
+    int count;
+    int capacity;
+    int hits;
+    int misses;
+    int refs;
+    struct friskMutex * lock;
+} friskRegexCache;
+
+friskRegexCache * friskRegexCacheCreate(int capacity);
+friskRegexCache * friskRegexCacheRetain(friskRegexCache * cache);
+void friskRegexCacheRelease(friskRegexCache * cache);
+
+// Returns the compiled regex, compiling and studying it first if it isn't cached. On a bad
+// pattern returns NULL and points *error at PCRE's message (errors aren't cached). Every regex
+// returned has to be handed back with friskRegexCachePut().
+friskCachedRegex * friskRegexCacheGet(friskRegexCache * cache, const char * pattern, int options, const char ** error);
+void friskRegexCachePut(friskRegexCache * cache, friskCachedRegex * cached);
+
+#endif
@@ -0,0 +1,144 @@
+#include "friskRender.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The longest thing any one input byte can turn into ("\line ")
+#define MAX_ESCAPE_LENGTH (6)
+
+// The most a highlight adds on top of its text (an SGR start plus a reset, or \cf2 plus \cf1)
+#define MAX_HIGHLIGHT_OVERHEAD (11)
+
+static const char *ansiColors[] =
+{
+    "\033[1;31m", "\033[1;32m", "\033[1;33m", "\033[1;34m", "\033[1;35m", "\033[1;36m"
+};
+#define ANSI_COLOR_COUNT (int)(sizeof(ansiColors) / sizeof(ansiColors[0]))
+#define ANSI_RESET "\033[0m"
+
+// ------------------------------------------------------------------------------------------------
+
+static void reserve(friskRenderer *renderer, int extra)
+{
+    int needed = renderer->length + extra + 1;
+    if(needed > renderer->capacity)
+    {
+        renderer->capacity = needed * 2;
+        renderer->output = (char *)realloc(renderer->output, renderer->capacity);
+    }
+}
+
+static char *writeString(char *out, const char *s, int len)
+{
+    memcpy(out, s, len);
+    return out + len;
+}
+
+static char *writeEscaped(friskRenderer *renderer, char *out, const char *text, int length)
+{
+    const char *end = text + length;
+    const char *c;
+    if(renderer->format == FRF_RTF)
+    {
+        for(c = text; c < end; ++c)
+        {
+            switch(*c)
+            {
+                case '\\': out = writeString(out, "\\\\", 2); break;
+                case '{':  out = writeString(out, "\\{", 2); break;
+                case '}':  out = writeString(out, "\\}", 2); break;
+                case '\n': out = writeString(out, "\\line ", 6); break;
+                case '\r': break;
+                default:   *out++ = *c; break;
+            }
+        }
+    }
+    else
+    {
+        // Don't let a file's contents drive the terminal
+        for(c = text; c < end; ++c)
+        {
+            unsigned char u = (unsigned char)*c;
+            *out++ = (((u < 0x20) && (u != '\t') && (u != '\n')) || (u == 0x7f)) ? '?' : *c;
+        }
+    }
+    return out;
+}
+
+static void render(friskRenderer *renderer, const char *text, int length, const friskHighlight *highlights, friskHighlight **pointers, int highlightCount)
+{
+    char *out;
+    int cursor = 0;
+    int i;
+
+    if(length < 0)
+        length = 0;
+    reserve(renderer, length * MAX_ESCAPE_LENGTH + highlightCount * MAX_HIGHLIGHT_OVERHEAD);
+    out = renderer->output + renderer->length;
+
+    for(i = 0; i < highlightCount; ++i)
+    {
+        const friskHighlight *highlight = pointers ? pointers[i] : &highlights[i];
+        int from = highlight->offset;
+        int to = highlight->offset + highlight->count;
+        if(from < cursor)
+            from = cursor;
+        if(to > length)
+            to = length;
+        if(from >= to)
+            continue;
+
+        out = writeEscaped(renderer, out, text + cursor, from - cursor);
+        if(renderer->format == FRF_RTF)
+        {
+            out = writeString(out, "\\cf2 ", 5);
+            out = writeEscaped(renderer, out, text + from, to - from);
+            out = writeString(out, "\\cf1 ", 5);
+        }
+        else
+        {
+            const char *color = ansiColors[((highlight->pattern > 0) ? highlight->pattern : 0) % ANSI_COLOR_COUNT];
+            out = writeString(out, color, (int)strlen(color));
+            out = writeEscaped(renderer, out, text + from, to - from);
+            out = writeString(out, ANSI_RESET, (int)strlen(ANSI_RESET));
+        }
+        cursor = to;
+    }
+    out = writeEscaped(renderer, out, text + cursor, length - cursor);
+
+    *out = 0;
+    renderer->length = (int)(out - renderer->output);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+friskRenderer * friskRendererCreate(int format)
+{
+    friskRenderer *renderer = (friskRenderer *)calloc(1, sizeof(friskRenderer));
+    renderer->format = format;
+    reserve(renderer, 1024);
+    renderer->output[0] = 0;
+    return renderer;
+}
+
+void friskRendererDestroy(friskRenderer * renderer)
+{
+    free(renderer->output);
+    free(renderer);
+}
+
+void friskRendererClear(friskRenderer * renderer)
+{
+    renderer->length = 0;
+    renderer->output[0] = 0;
+}
+
+void friskRendererAppend(friskRenderer * renderer, const char * text, int length, const friskHighlight * highlights, int highlightCount)
+{
+    render(renderer, text, length, highlights, NULL, highlightCount);
+}
+
+void friskRendererAppendEntry(friskRenderer * renderer, const char * text, int length, friskHighlight ** highlights, int highlightCount)
+{
+    render(renderer, text, length, NULL, highlights, highlightCount);
+}
@@ -0,0 +1,38 @@
+#ifndef FRISKRENDER_H
+#define FRISKRENDER_H
+
+#include "friskContext.h"
+
+// ------------------------------------------------------------------------------------------------
+// Turns text plus highlight spans into display markup in one linear pass. Every append works out
+// the most output it could produce, grows the buffer once if it has to, and then escapes and
+// colours straight into it, so rendering a big batch of results costs the same per byte as a
+// small one. The buffer is kept between Clear()s, so a renderer that gets reused stops allocating.
+//
+// Doesn't use dynamic, so the Win32 frontend can compile it in directly.
+
+typedef enum friskRenderFormat
+{
+    FRF_RTF = 0, // RichEdit body text: \cf1 for text, \cf2 for highlights; the caller writes the {\rtf1 header
+    FRF_ANSI     // terminal: SGR colours around highlights (one per pattern), control characters shown as '?'
+} friskRenderFormat;
+
+typedef struct friskRenderer
+{
+    int format;
+    char * output;  // always NUL terminated
+    int length;
+    int capacity;
+} friskRenderer;
+
+friskRenderer * friskRendererCreate(int format);
+void friskRendererDestroy(friskRenderer * renderer);
+void friskRendererClear(friskRenderer * renderer);
+
+// highlights must be sorted by offset; offsets are relative to text, and anything that overlaps
+// an earlier span or runs past length is clipped. The first takes them the way friskRow holds
+// them, the second the way friskEntry does.
+void friskRendererAppend(friskRenderer * renderer, const char * text, int length, const friskHighlight * highlights, int highlightCount);
+void friskRendererAppendEntry(friskRenderer * renderer, const char * text, int length, friskHighlight ** highlights, int highlightCount);
+
+#endif
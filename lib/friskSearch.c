@@ -0,0 +1,1816 @@
+#include "friskContext.h"
+#include "friskArchive.h"
+#include "friskBufferPool.h"
+#include "friskDecompress.h"
+#include "friskDfa.h"
+#include "friskEncoding.h"
+#include "friskIgnore.h"
+#include "friskMultiMatch.h"
+#include "friskMultiRegex.h"
+#include "friskPool.h"
+#include "friskReader.h"
+#include "friskRegexCache.h"
+
+#include "dynArray.h"
+#include "dynString.h"
+
+#include <pcre.h>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FRISK_PLATFORM_WIN32
+#include <windows.h>
+#define FRISK_PATH_SEPARATOR '\\'
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#define FRISK_PATH_SEPARATOR '/'
+#endif
+
+// How many files can be waiting to be merged per worker before the walk waits for the oldest
+#define FRISK_JOBS_PER_THREAD (32)
+
+// ------------------------------------------------------------------------------------------------
+
+// A file handed to a worker thread. Its results go into a private context (sharing params and the
+// regex cache) and are merged into the real one in the order the walk found the files, so the
+// output is the same as searching them one at a time.
+typedef struct friskSearchJob
+{
+    char *filename;
+    int isArchive;
+    int node;
+    int read;       // contents came from the reader stage
+    char *contents; // (NULL if it couldn't be read)
+    int size;
+    int capacity;
+    friskContext *results;
+    int done;
+} friskSearchJob;
+
+typedef struct friskSearchState
+{
+    friskContext *context;
+    friskCachedRegex **filespecRegexes;
+    friskCachedRegex *excludeRegex; // all of params->excludeFilespecs in one alternation
+    friskCachedRegex *pruneRegex;   // all of params->excludeDirectories
+    friskCachedRegex *matchRegex;
+    pcre_extra matchExtra;
+    friskDfa *matchDfa;
+    friskMultiMatch *multiMatch;
+    friskMultiRegex *multiRegex;
+    char **patterns;
+    int compileFlags; // PCRE options the patterns are compiled with, -1 when they're literals
+    int execOptions; // PCRE_NO_UTF8_CHECK once searchFile has validated the file itself
+    volatile int *stop; // the caller's context->stop, even while a worker's context is a private one
+    friskPool *pool;    // NULL when files are searched on the walking thread
+    friskReader *reader; // reads files ahead of the pool, if there is one
+    friskSearchJob **jobs; // ring of jobCapacity in flight, oldest first
+    int jobHead;
+    int jobCount;
+    int jobCapacity;
+    int nextNode; // the pool queue that the next top level directory's files go to
+    friskBufferPool *buffers;      // this thread's scratch (and file contents, unless...)
+    friskBufferPool *contentsPool; // ... they're read on another thread, into a shared pool
+} friskSearchState;
+
+static char *strstri(char *haystack, const char *needle)
+{
+    char *front = haystack;
+    for(; *front; front++)
+    {
+        const char *a = front;
+        const char *b = needle;
+
+        while(*a && *b)
+        {
+            if(tolower(*a) != tolower(*b))
+                break;
+            a++;
+            b++;
+        }
+        if(!*b)
+            return front;
+    }
+    return NULL;
+}
+
+static char *nextToken(char **p, char sep)
+{
+    char *front = *p;
+    char *end;
+    if(!front || !*front)
+        return NULL;
+
+    end = front;
+    while(*end && (*end != sep))
+    {
+        end++;
+    }
+    if(*end == sep)
+    {
+        *end = 0;
+        *p = end + 1;
+    }
+    else
+    {
+        *p = NULL;
+    }
+    return front;
+}
+
+// Pretty terrible and crazy stuff, but it matches what the Windows frontend has always done.
+static void convertWildcard(char **regex, const char *wildcard)
+{
+    const char *c;
+    dsCopy(regex, "^");
+    for(c = wildcard; *c; ++c)
+    {
+        switch(*c)
+        {
+            case '*':
+                dsConcat(regex, ".*");
+                break;
+            case '?':
+                dsConcat(regex, ".?");
+                break;
+            case '[':
+            case ']':
+            case '\\':
+            case '.':
+                dsConcatLen(regex, "\\", 1);
+                dsConcatLen(regex, c, 1);
+                break;
+            default:
+                dsConcatLen(regex, c, 1);
+                break;
+        }
+    }
+    dsConcat(regex, "$");
+}
+
+// For handing a literal pattern to PCRE
+static void escapeLiteral(char **regex, const char *literal)
+{
+    const char *c;
+    dsCopy(regex, "");
+    for(c = literal; *c; ++c)
+    {
+        if(((unsigned char)*c < 0x80) && !isalnum((unsigned char)*c))
+            dsConcatLen(regex, "\\", 1);
+        dsConcatLen(regex, c, 1);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+unsigned long long friskGetTickCount()
+{
+#ifdef FRISK_PLATFORM_WIN32
+    return GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((unsigned long long)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#endif
+}
+
+int friskReadEntireFile(const char *filename, char **contents, int *size, unsigned long long maxSizeKb, int ioPolicy)
+{
+    return friskReadPooledFile(NULL, filename, contents, size, NULL, maxSizeKb, ioPolicy);
+}
+
+int friskReadPooledFile(friskBufferPool *pool, const char *filename, char **contents, int *size, int *capacity, unsigned long long maxSizeKb, int ioPolicy)
+{
+    long long fileSize;
+    long long got = 0;
+    int room;
+#ifdef FRISK_PLATFORM_WIN32
+    FILE *f = fopen(filename, "rb");
+    if(!f)
+        return 0;
+
+    fseek(f, 0, SEEK_END);
+    fileSize = _ftelli64(f);
+    fseek(f, 0, SEEK_SET);
+#else
+    // Straight to the descriptor, so a read is an open, fstat, read and close, with nothing from
+    // the heap along the way
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+        return 0;
+    fileSize = fstat(fd, &st) ? 0 : (long long)st.st_size;
+#endif
+    if((fileSize <= 0) || (fileSize >= 0x7fffffff) || (maxSizeKb && ((unsigned long long)(fileSize / 1024) > maxSizeKb)))
+        goto failed;
+
+#ifdef FRISK_PLATFORM_WIN32
+    *contents = friskBufferPoolGet(pool, (int)fileSize + 1, &room);
+    got = (long long)fread(*contents, 1, (size_t)fileSize, f);
+    fclose(f);
+#else
+    friskAdviseRead(fd, ioPolicy);
+    *contents = friskBufferPoolGet(pool, (int)fileSize + 1, &room);
+    while(got < fileSize)
+    {
+        ssize_t bytes = read(fd, *contents + got, (size_t)(fileSize - got));
+        if((bytes < 0) && (errno == EINTR))
+            continue;
+        if(bytes <= 0)
+            break;
+        got += bytes;
+    }
+    friskAdviseDone(fd, fileSize, ioPolicy);
+    close(fd);
+#endif
+    if(got != fileSize)
+    {
+        friskBufferPoolPut(pool, *contents, room);
+        *contents = NULL;
+        return 0;
+    }
+    (*contents)[fileSize] = 0;
+    *size = (int)fileSize;
+    if(capacity)
+        *capacity = room;
+    return 1;
+
+failed:
+#ifdef FRISK_PLATFORM_WIN32
+    fclose(f);
+#else
+    close(fd);
+#endif
+    return 0;
+}
+
+int friskWriteEntireFile(const char *filename, const char *contents, int size)
+{
+    FILE *f = fopen(filename, "wb");
+    if(!f)
+        return 0;
+
+    fwrite(contents, 1, size, f);
+    fclose(f);
+    return 1;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Excludes are checked against the bare name as well as the whole path, so "third_party" prunes
+// that directory wherever it is and "*/gen/*.c" still works.
+static int excludeMatches(friskCachedRegex *regex, const char *path)
+{
+    const char *name = path;
+    const char *c;
+    if(!regex)
+        return 0;
+
+    // Archive entries use '/' even on Windows
+    for(c = path; *c; ++c)
+    {
+        if((*c == FRISK_PATH_SEPARATOR) || (*c == '/'))
+            name = c + 1;
+    }
+    if(pcre_exec(regex->regex, regex->study, name, (int)strlen(name), 0, 0, NULL, 0) >= 0)
+        return 1;
+    return (name != path) && (pcre_exec(regex->regex, regex->study, path, (int)strlen(path), 0, 0, NULL, 0) >= 0);
+}
+
+static int filespecMatches(friskSearchState *state, const char *filename)
+{
+    int i;
+    int count = daSize(&state->filespecRegexes);
+    if(excludeMatches(state->excludeRegex, filename))
+        return 0;
+    if(!count)
+        return 1;
+
+    for(i = 0; i < count; ++i)
+    {
+        friskCachedRegex *regex = state->filespecRegexes[i];
+        if(pcre_exec(regex->regex, regex->study, filename, (int)strlen(filename), 0, 0, NULL, 0) >= 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Looks for the next hit in line at or after start. Offsets are relative to the whole line so
+// anchors and lookbehinds see the text before start. Returns -1 if PCRE hit its match limits.
+static int findMatch(friskSearchState *state, char *line, int lineLen, int start, int *matchPos, int *matchLen, int *pattern)
+{
+    friskParams *params = state->context->params;
+
+    *pattern = 0;
+    if(state->matchDfa)
+    {
+        int rc = friskDfaFind(state->matchDfa, line, lineLen, start, matchPos, matchLen);
+        if(rc >= 0)
+            return rc;
+
+        // Ran out of room for DFA states, PCRE takes it from here
+        friskDfaDestroy(state->matchDfa);
+        state->matchDfa = NULL;
+    }
+    if(state->matchRegex)
+    {
+        int ovector[30];
+        int rc = pcre_exec(state->matchRegex->regex, &state->matchExtra, line, lineLen, start, state->execOptions, ovector, 30);
+        if((rc == PCRE_ERROR_MATCHLIMIT) || (rc == PCRE_ERROR_RECURSIONLIMIT) || (rc == PCRE_ERROR_JIT_STACKLIMIT))
+            return -1;
+        if(rc >= 0)
+        {
+            *matchPos = ovector[0];
+            *matchLen = ovector[1] - ovector[0];
+            return 1;
+        }
+    }
+    else if(state->multiRegex)
+    {
+        return friskMultiRegexFind(state->multiRegex, line, lineLen, start, matchPos, matchLen, pattern);
+    }
+    else if(state->multiMatch)
+    {
+        if(friskMultiMatchFind(state->multiMatch, line + start, lineLen - start, matchPos, matchLen, pattern))
+        {
+            *matchPos += start;
+            return 1;
+        }
+    }
+    else
+    {
+        const char *needle = state->patterns[0];
+        char *match;
+        if(params->flags & FSF_MATCH_CASE_SENSITIVE)
+            match = strstr(line + start, needle);
+        else
+            match = strstri(line + start, needle);
+        if(match != NULL)
+        {
+            *matchPos = (int)(match - line);
+            *matchLen = (int)strlen(needle);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// How far to step past an empty match so we don't spin on it: a byte, or a whole character when
+// the text is UTF-8 (PCRE must never be started partway through one)
+static int emptyMatchStep(friskSearchState *state, const char *text, int offset, int len)
+{
+    int step = 1;
+    if(state->context->params->flags & FSF_UTF8)
+    {
+        while((offset + step < len) && ((text[offset + step] & 0xC0) == 0x80))
+            step++;
+    }
+    return step;
+}
+
+static int countLines(const char *text, int len)
+{
+    int count = 0;
+    const char *end = text + len;
+    while((text = (const char *)memchr(text, '\n', end - text)) != NULL)
+    {
+        count++;
+        text++;
+    }
+    return count;
+}
+
+static void addMultilineEntry(friskContext *context, friskEntry *entry, const char *filename, const char *buffer, int start, int end)
+{
+    if((end > start) && (buffer[end - 1] == '\r'))
+        end--;
+    dsCopy(&entry->filename, filename);
+    dsCopyLen(&entry->match, buffer + start, end - start);
+    entry->offset = start;
+    daPush(&context->list, entry);
+}
+
+// FSF_MULTILINE: matches run over the whole buffer instead of line by line, so a hit can span
+// several lines. An entry covers entry->line through entry->endLine, its match is that stretch of
+// the file (newlines included) and its highlights are offsets into it. A hit that starts on a line
+// the current entry already covers is folded into it. Returns the number of hits.
+static int searchWholeBuffer(friskSearchState *state, const char *filename, char *buffer, int size, unsigned long long deadline, int *firstHitLine, char **skipReason)
+{
+    friskContext *context = state->context;
+    friskParams *params = context->params;
+    int summaryOnly = ((params->flags & (FSF_COUNT_HITS | FSF_FILES_WITH_HITS)) != 0);
+    friskEntry *entry = NULL;
+    int entryStart = 0;  // offset of the first line entry covers
+    int entryEnd = 0;    // offset of the '\n' (or end of buffer) that ends its last line
+    int counted = 0;     // lineNumber is the line that this offset is on
+    int lineNumber = 1;
+    int lastHitLine = 0;
+    int fileHits = 0;
+    int offset = 0;
+
+    while((offset <= size) && !*state->stop)
+    {
+        int stopFile = 0;
+        int matchPos;
+        int matchLen;
+        int pattern;
+        int rc;
+
+        if(deadline && (friskGetTickCount() > deadline))
+        {
+            dsPrintf(skipReason, "took longer than %d ms (gave up on line %d)", params->fileTimeLimit, lineNumber);
+            break;
+        }
+
+        rc = findMatch(state, buffer, size, offset, &matchPos, &matchLen, &pattern);
+        if(rc < 0)
+            dsPrintf(skipReason, "regex match limit exceeded after line %d", lineNumber);
+        if(rc <= 0)
+            break;
+
+        // An empty hit past the final newline would be on a line that doesn't exist
+        if(!matchLen && (matchPos == size) && size && (buffer[size - 1] == '\n'))
+            break;
+
+        lineNumber += countLines(buffer + counted, matchPos - counted);
+        counted = matchPos;
+        if(!fileHits)
+            *firstHitLine = lineNumber;
+        if(lineNumber != lastHitLine)
+            context->linesWithHits++;
+        lastHitLine = lineNumber;
+
+        context->hits++;
+        fileHits++;
+        if(params->maxHits && (context->hits >= params->maxHits))
+        {
+            context->truncated = 1;
+            *state->stop = 1;
+            stopFile = 1;
+        }
+        if(params->maxHitsPerFile && (fileHits >= params->maxHitsPerFile))
+        {
+            context->truncated = 1;
+            stopFile = 1;
+        }
+
+        if(!summaryOnly)
+        {
+            friskHighlight *highlight;
+            int lastChar = matchLen ? (matchPos + matchLen - 1) : matchPos;
+            const char *lineEnd;
+
+            if(entry && (matchPos > entryEnd))
+            {
+                addMultilineEntry(context, entry, filename, buffer, entryStart, entryEnd);
+                entry = NULL;
+            }
+            if(!entry)
+            {
+                entry = friskEntryCreate();
+                entry->line = lineNumber;
+                entryStart = matchPos;
+                while((entryStart > 0) && (buffer[entryStart - 1] != '\n'))
+                    entryStart--;
+            }
+
+            highlight = friskHighlightCreate();
+            highlight->offset = matchPos - entryStart;
+            highlight->count = matchLen;
+            highlight->pattern = pattern;
+            daPush(&entry->highlights, highlight);
+
+            if(lastChar >= entryEnd)
+            {
+                lineEnd = (lastChar < size) ? (const char *)memchr(buffer + lastChar, '\n', size - lastChar) : NULL;
+                entryEnd = lineEnd ? (int)(lineEnd - buffer) : size;
+                entry->endLine = lineNumber + countLines(buffer + matchPos, lastChar - matchPos);
+            }
+        }
+
+        if(stopFile || (summaryOnly && (params->flags & FSF_FILES_WITH_HITS)))
+            break;
+        offset = matchPos + matchLen + (matchLen ? 0 : emptyMatchStep(state, buffer, matchPos, size));
+    }
+
+    if(entry)
+        addMultilineEntry(context, entry, filename, buffer, entryStart, entryEnd);
+    return fileHits;
+}
+
+// Writes text back out in the encoding the file was read in
+static int writeText(const char *filename, const char *text, int len, friskEncoding encoding, int hasBom)
+{
+    int size;
+    int ret;
+    char *encoded;
+    if((encoding == FE_BYTES) || ((encoding == FE_UTF8_BOM) && !hasBom))
+        return friskWriteEntireFile(filename, text, len);
+
+    encoded = friskEncodeText(text, len, encoding, hasBom, &size);
+    ret = friskWriteEntireFile(filename, encoded, size);
+    free(encoded);
+    return ret;
+}
+
+// Searches a file that has already been read into contents (NUL terminated, from
+// state->contentsPool with room for capacity bytes, or malloc'd with a capacity of 0), and gives
+// it back. Files inside archives can't be replaced in, only searched.
+static int searchContents(friskSearchState *state, const char *filename, char *contents, int size, int capacity, int inArchive)
+{
+    friskContext *context = state->context;
+    friskParams *params = context->params;
+    int replacing = ((params->flags & FSF_REPLACE) != 0);
+    int summaryOnly = !replacing && (params->flags & (FSF_COUNT_HITS | FSF_FILES_WITH_HITS));
+    char *workBuffer;
+    int workCapacity = 0;
+    friskPooledText updated = { NULL, 0, 0 };
+    char *original = contents;
+    char *p;
+    char *line;
+    int atLeastOneMatch = 0;
+    int stopFile = 0;
+    char *rest = NULL;
+    int firstHitLine = 0;
+    int fileHits = 0;
+    int lineNumber = 1;
+    int ret = 1;
+    unsigned long long deadline = 0;
+    char *skipReason = NULL;
+    friskEncoding encoding;
+    int hasBom;
+    int wantContext = !replacing && !summaryOnly && !(params->flags & FSF_MULTILINE) && ((params->contextBefore > 0) || (params->contextAfter > 0));
+    friskBuffer *buffer = NULL;
+    char **beforeLines = NULL; // the last few lines that weren't hits or anyone's after-context
+    int beforeCapacity = 0;
+    int beforeCount = 0;
+    friskEntry *afterEntry = NULL;
+    int afterLeft = 0;
+    int firstEntry = daSize(&context->list);
+
+    if(inArchive && replacing)
+        dsCopy(&skipReason, "is inside an archive (replace only works on plain files)");
+    if(!skipReason && (params->flags & FSF_DECOMPRESS))
+    {
+        friskCompression compression = friskDetectCompression(contents, size);
+        if(compression != FC_NONE)
+        {
+            // There's nowhere sensible to put a replaced line inside a compressed file
+            if(replacing)
+                dsPrintf(&skipReason, "is %s compressed (replace only works on plain files)", friskCompressionName(compression));
+            else
+                friskDecompress(&contents, &size, compression, params->maxFileSize * 1024, &skipReason);
+        }
+    }
+
+    // Everything from here on sees UTF-8 (or whatever 8-bit text the file was to begin with)
+    encoding = skipReason ? FE_BYTES : friskDetectEncoding(contents, size);
+    hasBom = friskDecodeText(&contents, &size, encoding);
+    if(contents != original)
+    {
+        // Decompressing or decoding freed the pool's buffer and swapped in one of its own
+        friskBufferPoolForget(state->contentsPool, capacity);
+        capacity = 0;
+    }
+    if(!skipReason && (params->flags & FSF_UTF8))
+    {
+        int badOffset = friskValidateUtf8(contents, size);
+        if(badOffset >= 0)
+            dsPrintf(&skipReason, "isn't valid UTF-8 (byte %d)", badOffset);
+    }
+
+    // Only replacing needs the untouched contents afterwards
+    workBuffer = contents;
+    if(replacing)
+    {
+        workBuffer = friskBufferPoolGet(state->buffers, size + 1, &workCapacity);
+        memcpy(workBuffer, contents, size + 1);
+        friskPooledTextAppend(state->buffers, &updated, "", 0);
+    }
+    if(wantContext && (params->contextBefore > 0))
+        beforeLines = (char **)friskBufferPoolGet(state->buffers, (int)sizeof(char *) * params->contextBefore, &beforeCapacity);
+    if(params->fileTimeLimit > 0)
+        deadline = friskGetTickCount() + params->fileTimeLimit;
+
+    p = skipReason ? NULL : workBuffer;
+    if(p && (params->flags & FSF_MULTILINE))
+    {
+        fileHits = searchWholeBuffer(state, filename, workBuffer, size, deadline, &firstHitLine, &skipReason);
+        atLeastOneMatch = (fileHits > 0);
+        p = NULL;
+    }
+    while((line = nextToken(&p, '\n')) != NULL)
+    {
+        int lineStart = updated.length; // where this line's replacement starts in updated
+        friskEntry *entry = NULL;
+        int lineHits = 0;
+        int hasCarriageReturn = 0;
+        int lineLen = (int)strlen(line);
+        int offset = 0;
+        if(lineLen && (line[lineLen - 1] == '\r'))
+        {
+            line[--lineLen] = 0;
+            hasCarriageReturn = 1;
+        }
+
+        if(*state->stop)
+        {
+            rest = line;
+            break;
+        }
+
+        if(deadline && (friskGetTickCount() > deadline))
+        {
+            dsPrintf(&skipReason, "took longer than %d ms (gave up on line %d)", params->fileTimeLimit, lineNumber);
+            break;
+        }
+
+        do
+        {
+            friskHighlight *highlight;
+            int matchPos;
+            int matchLen;
+            int pattern;
+            int rc = findMatch(state, line, lineLen, offset, &matchPos, &matchLen, &pattern);
+            if(rc < 0)
+                dsPrintf(&skipReason, "regex match limit exceeded on line %d", lineNumber);
+            if(rc <= 0)
+                break;
+
+            context->hits++;
+            lineHits++;
+            if(params->maxHits && (context->hits >= params->maxHits))
+            {
+                context->truncated = 1;
+                *state->stop = 1;
+                stopFile = 1;
+            }
+            if(params->maxHitsPerFile && ((fileHits + lineHits) >= params->maxHitsPerFile))
+            {
+                context->truncated = 1;
+                stopFile = 1;
+            }
+            if(summaryOnly)
+            {
+                if(stopFile || (params->flags & FSF_FILES_WITH_HITS))
+                    break;
+                offset = matchPos + matchLen + (matchLen ? 0 : emptyMatchStep(state, line, matchPos, lineLen));
+                continue;
+            }
+
+            if(!entry)
+                entry = friskEntryCreate();
+            highlight = friskHighlightCreate();
+            highlight->pattern = pattern;
+            if(replacing)
+            {
+                friskPooledTextAppend(state->buffers, &updated, line + offset, matchPos - offset);
+                highlight->offset = updated.length - lineStart;
+                highlight->count = params->replace ? (int)strlen(params->replace) : 0;
+                if(params->replace)
+                    friskPooledTextAppend(state->buffers, &updated, params->replace, highlight->count);
+            }
+            else
+            {
+                highlight->offset = matchPos;
+                highlight->count = matchLen;
+            }
+            daPush(&entry->highlights, highlight);
+
+            offset = matchPos + matchLen;
+            if(!matchLen)
+            {
+                // Empty match (ex: "^"), step over a character so we don't spin here forever
+                int step;
+                if(offset >= lineLen)
+                    break;
+                step = emptyMatchStep(state, line, offset, lineLen);
+                if(replacing)
+                    friskPooledTextAppend(state->buffers, &updated, line + offset, step);
+                offset += step;
+            }
+        }
+        while(!stopFile && (offset < lineLen));
+
+        if(skipReason)
+        {
+            if(entry)
+                friskEntryDestroy(entry);
+            break;
+        }
+
+        if(lineHits)
+        {
+            context->linesWithHits++;
+            fileHits += lineHits;
+            if(!atLeastOneMatch)
+                firstHitLine = lineNumber;
+            atLeastOneMatch = 1;
+
+            // The first hit is all files-with-hits wants to know
+            if(summaryOnly && (params->flags & FSF_FILES_WITH_HITS))
+                break;
+        }
+
+        if(replacing)
+        {
+            int replacedLen;
+            if(offset < lineLen)
+                friskPooledTextAppend(state->buffers, &updated, line + offset, lineLen - offset);
+            replacedLen = updated.length - lineStart;
+            if(entry && ((replacedLen != lineLen) || memcmp(updated.data + lineStart, line, lineLen)))
+            {
+                dsCopy(&entry->filename, filename);
+                dsCopyLen(&entry->match, updated.data + lineStart, replacedLen);
+                entry->line = entry->endLine = lineNumber;
+                entry->offset = (int)(line - workBuffer);
+                daPush(&context->list, entry);
+                entry = NULL;
+            }
+            if(hasCarriageReturn)
+                friskPooledTextAppend(state->buffers, &updated, "\r", 1);
+            if(p)
+                friskPooledTextAppend(state->buffers, &updated, "\n", 1);
+        }
+        else if(entry)
+        {
+            dsCopy(&entry->filename, filename);
+            dsCopy(&entry->match, line);
+            entry->line = entry->endLine = lineNumber;
+            entry->offset = (int)(line - workBuffer);
+            daPush(&context->list, entry);
+            if(wantContext)
+            {
+                int i;
+                // Entries keep the file alive and point their context lines straight into it
+                if(!buffer)
+                {
+                    friskBufferPoolForget(state->contentsPool, capacity);
+                    capacity = 0;
+                    buffer = friskBufferCreate(contents, size);
+                }
+                entry->buffer = friskBufferRetain(buffer);
+                for(i = 0; i < beforeCount; ++i)
+                    daPush(&entry->before, beforeLines[i]);
+                beforeCount = 0;
+                afterEntry = entry;
+                afterLeft = params->contextAfter;
+            }
+            entry = NULL;
+        }
+        else if(wantContext)
+        {
+            if(afterLeft > 0)
+            {
+                daPush(&afterEntry->after, line);
+                afterLeft--;
+            }
+            else if(beforeLines)
+            {
+                if(beforeCount == params->contextBefore)
+                    memmove(beforeLines, beforeLines + 1, sizeof(char *) * --beforeCount);
+                beforeLines[beforeCount++] = line;
+            }
+        }
+        if(entry)
+            friskEntryDestroy(entry);
+        lineNumber++;
+
+        if(stopFile)
+        {
+            rest = p;
+            break;
+        }
+    }
+
+    // A hit limit still gets the trailing context of its last hit
+    if(stopFile && !skipReason)
+    {
+        while((afterLeft > 0) && ((line = nextToken(&p, '\n')) != NULL))
+        {
+            int lineLen = (int)strlen(line);
+            if(lineLen && (line[lineLen - 1] == '\r'))
+                line[lineLen - 1] = 0;
+            daPush(&afterEntry->after, line);
+            afterLeft--;
+        }
+    }
+
+    // Whatever wasn't looked at goes back into a replaced file untouched
+    if(replacing && rest && !skipReason)
+    {
+        const char *untouched = contents + (rest - workBuffer);
+        friskPooledTextAppend(state->buffers, &updated, untouched, (int)strlen(untouched));
+    }
+    if(atLeastOneMatch)
+    {
+        context->filesWithHits++;
+        if(params->maxFilesWithHits && (context->filesWithHits >= params->maxFilesWithHits))
+        {
+            context->truncated = 1;
+            *state->stop = 1;
+        }
+        if(summaryOnly)
+        {
+            friskEntry *entry = friskEntryCreate();
+            dsCopy(&entry->filename, filename);
+            entry->line = entry->endLine = firstHitLine;
+            entry->hits = fileHits;
+            daPush(&context->list, entry);
+        }
+    }
+
+    if(skipReason)
+    {
+        // Never write back a half-processed file
+        friskSkip *skip = friskSkipCreate();
+        dsCopy(&skip->filename, filename);
+        skip->reason = skipReason;
+        skipReason = NULL;
+        daPush(&context->skipped, skip);
+        ret = 0;
+    }
+    else if(replacing)
+    {
+        ret = 0;
+        if(updated.data && strcmp(contents, updated.data))
+        {
+            int overwriteFile = 1;
+            if(params->flags & FSF_BACKUP)
+            {
+                char *backupFilename = NULL;
+                dsPrintf(&backupFilename, "%s.%s", filename, params->backupExtension ? params->backupExtension : "friskbackup");
+                if(!writeText(backupFilename, contents, size, encoding, hasBom))
+                {
+                    char *warning = NULL;
+                    dsPrintf(&warning, "WARNING: Couldn't write backup file (skipping replacement): %s", backupFilename);
+                    daPush(&context->warnings, warning);
+                    overwriteFile = 0;
+                }
+                dsDestroy(&backupFilename);
+            }
+
+            if(overwriteFile)
+            {
+                if(writeText(filename, updated.data, updated.length, encoding, hasBom))
+                {
+                    ret = 1;
+                }
+                else
+                {
+                    char *warning = NULL;
+                    dsPrintf(&warning, "WARNING: Couldn't write to file: %s", filename);
+                    daPush(&context->warnings, warning);
+                }
+            }
+        }
+    }
+
+    if(context->onResults && (daSize(&context->list) > firstEntry))
+        context->onResults(context, firstEntry, context->userData);
+
+    friskPooledTextRelease(state->buffers, &updated);
+    friskBufferPoolPut(state->buffers, (char *)beforeLines, beforeCapacity);
+    if(workBuffer != contents)
+        friskBufferPoolPut(state->buffers, workBuffer, workCapacity);
+    if(buffer)
+        friskBufferRelease(buffer);
+    else
+        friskBufferPoolPut(state->contentsPool, contents, capacity);
+    return ret;
+}
+
+static int searchFile(friskSearchState *state, const char *filename)
+{
+    char *contents = NULL;
+    int size;
+    int capacity;
+
+    if(!friskReadPooledFile(state->contentsPool, filename, &contents, &size, &capacity, state->context->params->maxFileSize, state->context->params->ioPolicy))
+        return 0;
+    return searchContents(state, filename, contents, size, capacity, 0);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+static char *joinPath(const char *dir, const char *name)
+{
+    char *filename = dsDup(dir);
+    int len = dsLength(&filename);
+    if(!len || (filename[len - 1] != FRISK_PATH_SEPARATOR))
+    {
+        char separator = FRISK_PATH_SEPARATOR;
+        dsConcatLen(&filename, &separator, 1);
+    }
+    dsConcat(&filename, name);
+    return filename;
+}
+
+// FSF_ARCHIVES: an archive is walked like a directory, and each file in it is searched straight out
+// of memory as "archive!/inner/path". Filespecs apply to those names, not to the archive's own.
+static void searchArchive(friskSearchState *state, const char *filename)
+{
+    friskContext *context = state->context;
+    friskParams *params = context->params;
+    friskArchive *archive = NULL;
+    friskCompression compression;
+    char *contents = NULL;
+    char *original;
+    char *name = NULL;
+    char *error = NULL;
+    char *entryContents;
+    int entrySize;
+    int size;
+    int capacity;
+
+    if(!friskReadPooledFile(state->contentsPool, filename, &contents, &size, &capacity, 0, params->ioPolicy))
+    {
+        context->filesSkipped++;
+        return;
+    }
+    original = contents;
+    compression = friskDetectCompression(contents, size);
+    if((compression == FC_NONE) || friskDecompress(&contents, &size, compression, 0, &error))
+        archive = friskArchiveOpen(contents, size);
+    if(contents != original)
+    {
+        friskBufferPoolForget(state->contentsPool, capacity);
+        capacity = 0;
+    }
+    dsDestroy(&error);
+    if(!archive)
+    {
+        // Just a file with an archive-ish name
+        friskBufferPoolPut(state->contentsPool, contents, capacity);
+        if(filespecMatches(state, filename) && searchFile(state, filename))
+            context->filesSearched++;
+        else
+            context->filesSkipped++;
+        return;
+    }
+
+    context->directoriesSearched++;
+    while(!*state->stop && friskArchiveNext(archive, &name, &entryContents, &entrySize, params->maxFileSize * 1024, &error))
+    {
+        char *entryName = NULL;
+        dsPrintf(&entryName, "%s!/%s", filename, strncmp(name, "./", 2) ? name : name + 2);
+        if(!filespecMatches(state, entryName))
+        {
+            free(entryContents);
+            context->filesSkipped++;
+        }
+        else if(!entryContents)
+        {
+            friskSkip *skip = friskSkipCreate();
+            dsCopy(&skip->filename, entryName);
+            skip->reason = error;
+            error = NULL;
+            daPush(&context->skipped, skip);
+            context->filesSkipped++;
+        }
+        else if(searchContents(state, entryName, entryContents, entrySize, 0, 1))
+        {
+            context->filesSearched++;
+        }
+        else
+        {
+            context->filesSkipped++;
+        }
+        dsDestroy(&error);
+        dsDestroy(&entryName);
+    }
+    dsDestroy(&name);
+    friskArchiveClose(archive);
+    friskBufferPoolPut(state->contentsPool, contents, capacity);
+}
+
+// What the walker knows about a file before opening it. On Windows the find data has everything;
+// elsewhere a stat is only made if a size or time predicate needs one and the walk didn't already.
+typedef struct friskFileAttributes
+{
+    int known;
+    unsigned long long size; // bytes
+    long long modified;      // seconds since the epoch
+    unsigned long long inode; // from the directory entry, where there is one (for FIO_INODE_ORDER)
+} friskFileAttributes;
+
+// A directory waiting to be walked, with the ignore rules of the directory it was found in. With
+// FSF_SORTED files wait here too, so that they come out interleaved with directories in name order.
+typedef struct friskPendingPath
+{
+    char *path;
+    friskIgnore *ignore;
+    int depth; // 0 for the paths in params
+    int node;  // which of the pool's queues the files under it go to
+    int isFile;
+    friskFileAttributes attributes;
+} friskPendingPath;
+
+// attributes is NULL for a directory
+static void pushPendingPath(friskPendingPath ***pending, char *path, friskIgnore *ignore, int depth, int node, friskFileAttributes *attributes)
+{
+    friskPendingPath *directory = (friskPendingPath *)calloc(1, sizeof(friskPendingPath));
+    directory->path = path;
+    directory->ignore = ignore ? friskIgnoreRetain(ignore) : NULL;
+    directory->depth = depth;
+    directory->node = node;
+    if(attributes)
+    {
+        directory->isFile = 1;
+        directory->attributes = *attributes;
+    }
+    daPush(pending, directory);
+}
+
+static void destroyPendingPath(friskPendingPath *directory)
+{
+    dsDestroy(&directory->path);
+    friskIgnoreRelease(directory->ignore);
+    free(directory);
+}
+
+static int comparePendingPaths(const void *a, const void *b)
+{
+    const friskPendingPath *pathA = *(const friskPendingPath **)a;
+    const friskPendingPath *pathB = *(const friskPendingPath **)b;
+    return strcmp(pathA->path, pathB->path);
+}
+
+// Sorts everything one directory turned up and moves it onto the stack, last name first so the
+// first name is popped first. Everything in found shares a parent, so comparing the full paths
+// orders them by name, and the walk as a whole comes out in path order.
+static void queueSorted(friskPendingPath ***found, friskPendingPath ***pending)
+{
+    int count = daSize(found);
+    int i;
+    if(count > 1)
+        qsort(*found, count, sizeof(friskPendingPath *), comparePendingPaths);
+    for(i = count - 1; i >= 0; --i)
+        daPush(pending, (*found)[i]);
+    daDestroy(found, NULL);
+}
+
+static int compareInodes(const void *a, const void *b)
+{
+    const friskPendingPath *pathA = *(const friskPendingPath **)a;
+    const friskPendingPath *pathB = *(const friskPendingPath **)b;
+    if(pathA->attributes.inode != pathB->attributes.inode)
+        return (pathA->attributes.inode < pathB->attributes.inode) ? -1 : 1;
+    return 0;
+}
+
+static int attributesMatch(friskSearchState *state, const char *filename, friskFileAttributes *attributes, int isArchive)
+{
+    friskParams *params = state->context->params;
+    // Archives are held to maxFileSize entry by entry, not as a whole
+    unsigned long long maxFileSize = isArchive ? 0 : params->maxFileSize;
+
+    if(!maxFileSize && !params->minFileSize && !params->modifiedAfter && !params->modifiedBefore)
+        return 1;
+#ifndef FRISK_PLATFORM_WIN32
+    if(!attributes->known)
+    {
+        struct stat st;
+        if(stat(filename, &st))
+            return 0;
+        attributes->known = 1;
+        attributes->size = (unsigned long long)st.st_size;
+        attributes->modified = (long long)st.st_mtime;
+    }
+#endif
+
+    if(maxFileSize && ((attributes->size / 1024) > maxFileSize))
+        return 0;
+    if(params->minFileSize && ((attributes->size / 1024) < params->minFileSize))
+        return 0;
+    if(params->modifiedAfter && (attributes->modified < params->modifiedAfter))
+        return 0;
+    if(params->modifiedBefore && (attributes->modified >= params->modifiedBefore))
+        return 0;
+    return 1;
+}
+
+static void searchVisited(friskSearchState *state, const char *filename, int isArchive)
+{
+    friskContext *context = state->context;
+    if(isArchive)
+    {
+        searchArchive(state, filename);
+        return;
+    }
+    if(searchFile(state, filename))
+        context->filesSearched++;
+    else
+        context->filesSkipped++;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// A private context for a worker's results; everything but the results is borrowed from context
+static friskContext *createResults(friskContext *context)
+{
+    friskContext *results = (friskContext *)calloc(1, sizeof(friskContext));
+    results->params = context->params;
+    results->config = context->config;
+    results->regexCache = context->regexCache;
+    return results;
+}
+
+static void destroyResults(friskContext *results)
+{
+    daDestroy(&results->list, friskEntryDestroy);
+    dsDestroy(&results->error);
+    daDestroyStrings(&results->warnings);
+    daDestroy(&results->skipped, friskSkipDestroy);
+    free(results);
+}
+
+// Moves a finished job's results over to the end of context's
+static void mergeResults(friskContext *context, friskContext *results)
+{
+    int firstEntry = daSize(&context->list);
+    int i;
+
+    for(i = 0; i < daSize(&results->list); ++i)
+        daPush(&context->list, results->list[i]);
+    for(i = 0; i < daSize(&results->warnings); ++i)
+        daPush(&context->warnings, results->warnings[i]);
+    for(i = 0; i < daSize(&results->skipped); ++i)
+        daPush(&context->skipped, results->skipped[i]);
+    daClear(&results->list, NULL);
+    daClear(&results->warnings, NULL);
+    daClear(&results->skipped, NULL);
+
+    context->directoriesSearched += results->directoriesSearched;
+    context->filesSearched += results->filesSearched;
+    context->filesSkipped += results->filesSkipped;
+    context->filesWithHits += results->filesWithHits;
+    context->linesWithHits += results->linesWithHits;
+    context->hits += results->hits;
+    if(results->truncated)
+        context->truncated = 1;
+
+    if(context->onResults && (daSize(&context->list) > firstEntry))
+        context->onResults(context, firstEntry, context->userData);
+}
+
+// Merges finished jobs from the front of the ring, stopping at the first that's still running
+// unless wait is set
+static void mergeJobs(friskSearchState *state, int wait)
+{
+    while(state->jobCount)
+    {
+        friskSearchJob *job = state->jobs[state->jobHead];
+        if(wait)
+            friskPoolWait(state->pool, &job->done);
+        else if(!friskPoolIsDone(state->pool, &job->done))
+            break;
+
+        mergeResults(state->context, job->results);
+        destroyResults(job->results);
+        dsDestroy(&job->filename);
+        free(job);
+        state->jobHead = (state->jobHead + 1) % state->jobCapacity;
+        state->jobCount--;
+    }
+}
+
+static void submitJob(friskSearchState *state, const char *filename, int isArchive, int node)
+{
+    friskSearchJob *job = (friskSearchJob *)calloc(1, sizeof(friskSearchJob));
+    job->filename = dsDup(filename);
+    job->isArchive = isArchive;
+    job->node = node;
+    job->results = createResults(state->context);
+
+    mergeJobs(state, 0);
+    while(state->jobCount == state->jobCapacity)
+    {
+        friskPoolWait(state->pool, &state->jobs[state->jobHead]->done);
+        mergeJobs(state, 0);
+    }
+    state->jobs[(state->jobHead + state->jobCount) % state->jobCapacity] = job;
+    state->jobCount++;
+
+    // Archives read themselves, as they're searched entry by entry
+    if(state->reader && !isArchive)
+        friskReaderSubmit(state->reader, job->filename, job);
+    else
+        friskPoolSubmit(state->pool, node, job, &job->done);
+}
+
+static void visitFile(friskSearchState *state, const char *filename, friskFileAttributes *attributes, int node)
+{
+    friskContext *context = state->context;
+    int isArchive = ((context->params->flags & FSF_ARCHIVES) && friskArchiveNameMatches(filename));
+
+    // Names first, then sizes and times, and only then is anything opened. An archive can be
+    // excluded, but include filespecs apply to its entries, not to it.
+    if((isArchive ? excludeMatches(state->excludeRegex, filename) : !filespecMatches(state, filename)) || !attributesMatch(state, filename, attributes, isArchive))
+    {
+        context->filesSkipped++;
+        return;
+    }
+    if(state->pool)
+        submitJob(state, filename, isArchive, node);
+    else
+        searchVisited(state, filename, isArchive);
+}
+
+// FIO_INODE_ORDER: searches the files one directory turned up in inode order, which most
+// filesystems allocate roughly in disk order, so a cold walk isn't seeking back and forth
+static void visitInodeOrder(friskSearchState *state, friskPendingPath ***files)
+{
+    int count = daSize(files);
+    int i;
+    if(count > 1)
+        qsort(*files, count, sizeof(friskPendingPath *), compareInodes);
+    for(i = 0; i < count; ++i)
+    {
+        if(!state->context->stop)
+            visitFile(state, (*files)[i]->path, &(*files)[i]->attributes, (*files)[i]->node);
+        destroyPendingPath((*files)[i]);
+    }
+    daDestroy(files, NULL);
+}
+
+// Queues a subdirectory found while walking directory, unless it's already as deep as allowed
+static void queueDirectory(friskSearchState *state, friskPendingPath *directory, char *filename, friskIgnore *ignore, friskPendingPath ***pending)
+{
+    friskContext *context = state->context;
+    int maxDepth = context->params->maxDepth;
+    if(!(context->params->flags & FSF_RECURSIVE))
+    {
+        dsDestroy(&filename);
+        return;
+    }
+    if(maxDepth && (directory->depth + 1 >= maxDepth))
+    {
+        context->directoriesSkipped++;
+        dsDestroy(&filename);
+        return;
+    }
+
+    // Each top level directory's subtree goes to one node's queue, so a node's workers keep to
+    // their own part of the tree
+    pushPendingPath(pending, filename, ignore, directory->depth + 1, directory->depth ? directory->node : state->nextNode++, NULL);
+}
+
+// Searches a file as soon as the walk finds it, or holds on to it until its directory is sorted
+// (by name, or by inode)
+static void queueFile(friskSearchState *state, friskPendingPath *directory, char *filename, friskFileAttributes *attributes, friskPendingPath ***found)
+{
+    if(found)
+    {
+        pushPendingPath(found, filename, NULL, 0, directory->node, attributes);
+        return;
+    }
+    visitFile(state, filename, attributes, directory->node);
+    dsDestroy(&filename);
+}
+
+// A path from params can name a file as well as a directory; one that isn't there at all is warned
+// about rather than quietly turning up nothing
+static void queueRootPath(friskSearchState *state, const char *path, friskPendingPath ***roots)
+{
+    friskContext *context = state->context;
+    friskFileAttributes attributes;
+    int isDirectory;
+#ifdef FRISK_PLATFORM_WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    int exists = GetFileAttributesEx(path, GetFileExInfoStandard, &data);
+#else
+    struct stat st;
+    int exists = !stat(path, &st);
+#endif
+
+    if(!exists)
+    {
+        char *warning = NULL;
+        dsPrintf(&warning, "WARNING: No such file or directory: %s", path);
+        daPush(&context->warnings, warning);
+        return;
+    }
+
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.known = 1;
+#ifdef FRISK_PLATFORM_WIN32
+    {
+        unsigned long long lastWrite = ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+        isDirectory = ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+        attributes.size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        attributes.modified = (long long)(lastWrite / 10000000ULL) - 11644473600LL; // FILETIME is 100ns ticks since 1601
+    }
+#else
+    isDirectory = S_ISDIR(st.st_mode);
+    attributes.size = (unsigned long long)st.st_size;
+    attributes.modified = (long long)st.st_mtime;
+    attributes.inode = (unsigned long long)st.st_ino;
+#endif
+    pushPendingPath(roots, dsDup(path), NULL, 0, state->nextNode++, isDirectory ? NULL : &attributes);
+}
+
+#ifdef FRISK_PLATFORM_WIN32
+static void searchDirectory(friskSearchState *state, friskPendingPath *directory, friskIgnore *ignore, friskPendingPath ***pending)
+{
+    friskContext *context = state->context;
+    char *wildcard = joinPath(directory->path, "*");
+    WIN32_FIND_DATA wfd;
+    HANDLE findHandle = FindFirstFile(wildcard, &wfd);
+    friskPendingPath **found = NULL;
+    int sorted = (context->params->flags & FSF_SORTED);
+    dsDestroy(&wildcard);
+    if(findHandle == INVALID_HANDLE_VALUE)
+        return;
+
+    // FindFirstFile() has already filled in the first entry
+    do
+    {
+        int isDirectory = ((wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+        char *filename;
+
+        if((wfd.cFileName[0] == '.') || (wfd.cFileName[0] == 0))
+        {
+            if(isDirectory)
+                context->directoriesSkipped++;
+            else
+                context->filesSkipped++;
+            continue;
+        }
+
+        filename = joinPath(directory->path, wfd.cFileName);
+        if((isDirectory && excludeMatches(state->pruneRegex, filename)) || friskIgnoreMatches(ignore, filename, isDirectory))
+        {
+            // Pruned here, so nothing under an excluded or ignored directory is ever opened
+            if(isDirectory)
+                context->directoriesSkipped++;
+            else
+                context->filesSkipped++;
+        }
+        else if(isDirectory)
+        {
+            queueDirectory(state, directory, filename, ignore, sorted ? &found : pending);
+            filename = NULL;
+        }
+        else
+        {
+            friskFileAttributes attributes;
+            unsigned long long lastWrite = ((unsigned long long)wfd.ftLastWriteTime.dwHighDateTime << 32) | wfd.ftLastWriteTime.dwLowDateTime;
+            attributes.known = 1;
+            attributes.inode = 0;
+            attributes.size = ((unsigned long long)wfd.nFileSizeHigh << 32) | wfd.nFileSizeLow;
+            attributes.modified = (long long)(lastWrite / 10000000ULL) - 11644473600LL; // FILETIME is 100ns ticks since 1601
+            queueFile(state, directory, filename, &attributes, sorted ? &found : NULL);
+            filename = NULL;
+        }
+        dsDestroy(&filename);
+    } while(!context->stop && FindNextFile(findHandle, &wfd));
+    FindClose(findHandle);
+    if(sorted)
+        queueSorted(&found, pending);
+}
+#else
+static void searchDirectory(friskSearchState *state, friskPendingPath *directory, friskIgnore *ignore, friskPendingPath ***pending)
+{
+    friskContext *context = state->context;
+    struct dirent *ent;
+    DIR *dir = opendir(directory->path);
+    friskPendingPath **found = NULL;
+    friskPendingPath **files = NULL;
+    int sorted = (context->params->flags & FSF_SORTED);
+    int byInode = !sorted && (context->params->ioPolicy & FIO_INODE_ORDER);
+    if(!dir)
+        return;
+
+    while(!context->stop && ((ent = readdir(dir)) != NULL))
+    {
+        char *filename;
+        int isDirectory = 0;
+        int isFile = 0;
+        friskFileAttributes attributes;
+        struct stat st;
+
+        if((ent->d_name[0] == '.') || (ent->d_name[0] == 0))
+        {
+            if(strcmp(ent->d_name, ".") && strcmp(ent->d_name, ".."))
+                context->filesSkipped++;
+            continue;
+        }
+
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.inode = (unsigned long long)ent->d_ino;
+        filename = joinPath(directory->path, ent->d_name);
+#ifdef _DIRENT_HAVE_D_TYPE
+        if(ent->d_type == DT_DIR)
+            isDirectory = 1;
+        else if(ent->d_type == DT_REG)
+            isFile = 1;
+        else
+#endif
+        if(!lstat(filename, &st))
+        {
+            if(S_ISDIR(st.st_mode))
+                isDirectory = 1;
+            else if(S_ISREG(st.st_mode))
+                isFile = 1;
+            else if(S_ISLNK(st.st_mode) && !stat(filename, &st) && S_ISREG(st.st_mode))
+                isFile = 1; // symlinked files are searched, symlinked directories aren't followed
+
+            // Already paid for, so the size and time predicates don't need another one
+            if(isFile)
+            {
+                attributes.known = 1;
+                attributes.size = (unsigned long long)st.st_size;
+                attributes.modified = (long long)st.st_mtime;
+            }
+        }
+
+        if((isDirectory && excludeMatches(state->pruneRegex, filename)) || ((isDirectory || isFile) && friskIgnoreMatches(ignore, filename, isDirectory)))
+        {
+            // Pruned here, so nothing under an excluded or ignored directory is ever opened
+            if(isDirectory)
+                context->directoriesSkipped++;
+            else
+                context->filesSkipped++;
+        }
+        else if(isDirectory)
+        {
+            queueDirectory(state, directory, filename, ignore, sorted ? &found : pending);
+            filename = NULL;
+        }
+        else if(isFile)
+        {
+            queueFile(state, directory, filename, &attributes, sorted ? &found : (byInode ? &files : NULL));
+            filename = NULL;
+        }
+        else
+        {
+            context->filesSkipped++;
+        }
+        dsDestroy(&filename);
+    }
+    closedir(dir);
+    if(sorted)
+        queueSorted(&found, pending);
+    else if(byInode)
+        visitInodeOrder(state, &files);
+}
+#endif
+
+// ------------------------------------------------------------------------------------------------
+
+// Folds a list of exclude filespecs into a single regex, so checking a name costs one pcre_exec no
+// matter how many there are. Leaves regex NULL if the list is empty.
+static int compileExcludes(friskSearchState *state, char **filespecs, friskCachedRegex **regex)
+{
+    friskParams *params = state->context->params;
+    char *combined = NULL;
+    const char *error;
+    int flags = 0;
+    int i;
+
+    for(i = 0; i < daSize(&filespecs); ++i)
+    {
+        char *regexString = NULL;
+        if(params->flags & FSF_FILESPEC_REGEXES)
+            dsCopy(&regexString, filespecs[i]);
+        else
+            convertWildcard(&regexString, filespecs[i]);
+        if(combined)
+            dsConcat(&combined, "|");
+        dsConcat(&combined, "(?:");
+        dsConcat(&combined, regexString);
+        dsConcat(&combined, ")");
+        dsDestroy(&regexString);
+    }
+    if(!combined)
+        return 1;
+
+    if(!(params->flags & FSF_FILESPEC_CASE_SENSITIVE))
+        flags |= PCRE_CASELESS;
+    *regex = friskRegexCacheGet(state->context->regexCache, combined, flags, &error);
+    dsDestroy(&combined);
+    if(!*regex)
+    {
+        dsPrintf(&state->context->error, "Exclude Regex Error: %s", error);
+        return 0;
+    }
+    return 1;
+}
+
+// Builds whatever findMatch() needs for state->patterns. Everything here is the searching
+// thread's own, as the DFA grows and the multi-pattern matchers keep scratch space.
+static int createMatchers(friskSearchState *state)
+{
+    friskContext *context = state->context;
+    friskParams *params = context->params;
+    int flags = state->compileFlags;
+    const char *error;
+
+    if(flags >= 0)
+    {
+        if(daSize(&state->patterns) > 1)
+        {
+            state->multiRegex = friskMultiRegexCreate(state->patterns, flags, params->matchLimit, params->matchLimitRecursion, &context->error);
+            if(!state->multiRegex)
+                return 0;
+        }
+        else
+        {
+            state->matchRegex = friskRegexCacheGet(context->regexCache, state->patterns[0], flags, &error);
+            if(!state->matchRegex)
+            {
+                dsPrintf(&context->error, "Match Regex Error: %s", error);
+                return 0;
+            }
+            friskSetMatchLimits(&state->matchExtra, state->matchRegex->study, params->matchLimit, params->matchLimitRecursion);
+
+            // Simple patterns get a linear time DFA; NULL here just means PCRE does the work. It only
+            // knows single-line, byte-at-a-time semantics, so multiline and UTF-8 modes always go
+            // through PCRE.
+            if(!(params->flags & (FSF_MULTILINE | FSF_UTF8)))
+                state->matchDfa = friskDfaCreate(state->patterns[0], (flags & PCRE_CASELESS) ? 1 : 0, FRISK_DFA_MEMORY_LIMIT);
+        }
+    }
+    else if(daSize(&state->patterns) > 1)
+    {
+        state->multiMatch = friskMultiMatchCreate(state->patterns, (params->flags & FSF_MATCH_CASE_SENSITIVE) ? 1 : 0);
+    }
+    return 1;
+}
+
+static void destroyMatchers(friskSearchState *state)
+{
+    friskRegexCachePut(state->context->regexCache, state->matchRegex);
+    if(state->matchDfa)
+        friskDfaDestroy(state->matchDfa);
+    if(state->multiMatch)
+        friskMultiMatchDestroy(state->multiMatch);
+    if(state->multiRegex)
+        friskMultiRegexDestroy(state->multiRegex);
+}
+
+static int compileSearch(friskSearchState *state)
+{
+    friskContext *context = state->context;
+    friskParams *params = context->params;
+    const char *error;
+    int useRegexes;
+    int i;
+
+    if(!friskParamsPatterns(params, &state->patterns))
+    {
+        dsPrintf(&context->error, "Couldn't read match file: %s", params->matchFile);
+        return 0;
+    }
+    if(!daSize(&state->patterns))
+    {
+        dsCopy(&context->error, "Nothing to search for");
+        return 0;
+    }
+    if((params->flags & FSF_MULTILINE) && (params->flags & FSF_REPLACE))
+    {
+        dsCopy(&context->error, "Replace isn't supported in multiline mode");
+        return 0;
+    }
+    if((params->flags & FSF_MULTILINE) && ((params->contextBefore > 0) || (params->contextAfter > 0)))
+    {
+        char *warning = NULL;
+        dsCopy(&warning, "WARNING: Context lines aren't shown in multiline mode");
+        daPush(&context->warnings, warning);
+    }
+
+    // strstri() and the Aho-Corasick tables only fold ASCII, so caseless UTF-8 literals are escaped
+    // and left to PCRE, which knows the Unicode case tables
+    useRegexes = (params->flags & FSF_MATCH_REGEXES);
+    if(!useRegexes && (params->flags & FSF_UTF8) && !(params->flags & FSF_MATCH_CASE_SENSITIVE))
+    {
+        for(i = 0; i < daSize(&state->patterns); ++i)
+        {
+            char *regex = NULL;
+            escapeLiteral(&regex, state->patterns[i]);
+            dsDestroy(&state->patterns[i]);
+            state->patterns[i] = regex;
+        }
+        useRegexes = 1;
+    }
+
+    state->compileFlags = -1;
+    if(useRegexes)
+    {
+        state->compileFlags = 0;
+        if(!(params->flags & FSF_MATCH_CASE_SENSITIVE))
+            state->compileFlags |= PCRE_CASELESS;
+        if(params->flags & FSF_MULTILINE)
+            state->compileFlags |= PCRE_MULTILINE | PCRE_DOTALL | PCRE_NEWLINE_ANYCRLF;
+        if(params->flags & FSF_UTF8)
+        {
+            state->compileFlags |= PCRE_UTF8;
+            state->execOptions = PCRE_NO_UTF8_CHECK;
+        }
+    }
+    if(!createMatchers(state))
+        return 0;
+
+    for(i = 0; i < daSize(&params->filespecs); ++i)
+    {
+        char *regexString = NULL;
+        int flags = 0;
+        friskCachedRegex *regex;
+
+        if(params->flags & FSF_FILESPEC_REGEXES)
+            dsCopy(&regexString, params->filespecs[i]);
+        else
+            convertWildcard(&regexString, params->filespecs[i]);
+        if(!(params->flags & FSF_FILESPEC_CASE_SENSITIVE))
+            flags |= PCRE_CASELESS;
+
+        regex = friskRegexCacheGet(context->regexCache, regexString, flags, &error);
+        dsDestroy(&regexString);
+        if(!regex)
+        {
+            dsPrintf(&context->error, "Filespec Regex Error: %s", error);
+            return 0;
+        }
+        daPush(&state->filespecRegexes, regex);
+    }
+    return compileExcludes(state, params->excludeFilespecs, &state->excludeRegex)
+        && compileExcludes(state, params->excludeDirectories, &state->pruneRegex);
+}
+
+// Runs on the worker thread, so its DFA and scratch space are allocated where it runs. Only the
+// parts of shared that stay put once the search has been compiled are read. Scratch comes from a
+// pool of the worker's own; file contents do too, unless the reader stage fills them.
+static void *createSearchWorker(void *userData, int worker, int node)
+{
+    friskSearchState *shared = (friskSearchState *)userData;
+    friskSearchState *state = (friskSearchState *)calloc(1, sizeof(friskSearchState));
+    (void)worker;
+    (void)node;
+    state->context = createResults(shared->context); // only ever holds a (very unlikely) error
+    state->filespecRegexes = shared->filespecRegexes;
+    state->excludeRegex = shared->excludeRegex;
+    state->pruneRegex = shared->pruneRegex;
+    state->patterns = shared->patterns;
+    state->compileFlags = shared->compileFlags;
+    state->execOptions = shared->execOptions;
+    state->stop = shared->stop;
+    state->buffers = friskBufferPoolCreate(0);
+    state->contentsPool = (shared->contentsPool != shared->buffers) ? shared->contentsPool : state->buffers;
+    createMatchers(state);
+    return state;
+}
+
+// Runs on a reader thread, and passes the file on to be searched
+static void onJobRead(void *userData, void *request, char *contents, int size, int capacity)
+{
+    friskSearchState *shared = (friskSearchState *)userData;
+    friskSearchJob *job = (friskSearchJob *)request;
+    job->read = 1;
+    job->contents = contents;
+    job->size = size;
+    job->capacity = capacity;
+    friskPoolSubmit(shared->pool, job->node, job, &job->done);
+}
+
+static void runSearchJob(void *worker, void *jobData)
+{
+    friskSearchState *state = (friskSearchState *)worker;
+    friskSearchJob *job = (friskSearchJob *)jobData;
+    friskContext *scratch = state->context;
+    if(*state->stop)
+    {
+        friskBufferPoolPut(state->contentsPool, job->contents, job->capacity);
+        return;
+    }
+    state->context = job->results;
+    if(!job->read)
+        searchVisited(state, job->filename, job->isArchive);
+    else if(job->contents && searchContents(state, job->filename, job->contents, job->size, job->capacity, 0))
+        job->results->filesSearched++;
+    else
+        job->results->filesSkipped++;
+    state->context = scratch;
+}
+
+static void destroySearchWorker(void *worker)
+{
+    friskSearchState *state = (friskSearchState *)worker;
+    destroyMatchers(state);
+    destroyResults(state->context);
+    friskBufferPoolDestroy(state->buffers);
+    free(state);
+}
+
+int friskContextSearch(friskContext *context)
+{
+    friskSearchState state;
+    friskPendingPath **pending = NULL;
+    friskPendingPath **roots = NULL;
+    int threads;
+    int ret = 0;
+    int i;
+
+    memset(&state, 0, sizeof(state));
+    state.context = context;
+    state.stop = &context->stop;
+    state.buffers = friskBufferPoolCreate(0);
+    state.contentsPool = state.buffers;
+
+    context->directoriesSearched = 0;
+    context->directoriesSkipped = 0;
+    context->filesSearched = 0;
+    context->filesSkipped = 0;
+    context->filesWithHits = 0;
+    context->linesWithHits = 0;
+    context->hits = 0;
+    context->truncated = 0;
+    context->stop = 0;
+    dsDestroy(&context->error);
+    daClear(&context->list, friskEntryDestroy);
+    daDestroyStrings(&context->warnings);
+    daClear(&context->skipped, friskSkipDestroy);
+
+    if(!compileSearch(&state))
+        goto cleanup;
+
+    // The walk stays on this thread and hands files to the pool. Hit limits have to be counted in
+    // the order files are searched, so those searches stay on this thread too.
+    threads = friskPoolThreadCount(context->params->threads);
+    if((threads > 1) && !context->params->maxHits && !context->params->maxFilesWithHits)
+    {
+        // Files the reader stage reads are searched (and finished with) on the workers
+        if(context->params->readDepth >= 0)
+            state.contentsPool = friskBufferPoolCreate(1);
+        state.pool = friskPoolCreate(threads, context->params->threadPolicy, createSearchWorker, runSearchJob, destroySearchWorker, &state);
+        if(state.pool)
+        {
+            state.jobCapacity = state.pool->threadCount * FRISK_JOBS_PER_THREAD;
+            if(context->params->readDepth >= 0)
+            {
+                state.reader = friskReaderCreate(context->params->readDepth, context->params->maxFileSize, context->params->ioPolicy, state.contentsPool, onJobRead, &state);
+                if(state.reader)
+                    state.jobCapacity += state.reader->depth;
+            }
+            state.jobs = (friskSearchJob **)calloc(state.jobCapacity, sizeof(friskSearchJob *));
+        }
+    }
+
+    for(i = 0; i < daSize(&context->params->paths); ++i)
+        queueRootPath(&state, context->params->paths[i], &roots);
+
+    // Popped from the back, so push in reverse to visit paths in the order given
+    for(i = daSize(&roots) - 1; i >= 0; --i)
+        daPush(&pending, roots[i]);
+    daDestroy(&roots, NULL);
+
+    while(daSize(&pending) && !context->stop)
+    {
+        friskPendingPath *directory = (friskPendingPath *)daPop(&pending);
+        friskIgnore *ignore = directory->ignore;
+        if(directory->isFile)
+        {
+            visitFile(&state, directory->path, &directory->attributes, directory->node);
+            destroyPendingPath(directory);
+            continue;
+        }
+        if(context->params->flags & FSF_IGNORE_FILES)
+            ignore = friskIgnoreLoad(directory->ignore, directory->path);
+        else if(ignore)
+            friskIgnoreRetain(ignore);
+        context->directoriesSearched++;
+        searchDirectory(&state, directory, ignore, &pending);
+        friskIgnoreRelease(ignore);
+        destroyPendingPath(directory);
+    }
+    ret = 1;
+
+cleanup:
+    if(state.pool)
+    {
+        mergeJobs(&state, 1);
+        friskReaderDestroy(state.reader);
+        friskPoolDestroy(state.pool);
+    }
+    free(state.jobs);
+    if(state.contentsPool != state.buffers)
+        friskBufferPoolDestroy(state.contentsPool);
+    friskBufferPoolDestroy(state.buffers);
+    daDestroy(&pending, destroyPendingPath);
+    for(i = 0; i < daSize(&state.filespecRegexes); ++i)
+        friskRegexCachePut(context->regexCache, state.filespecRegexes[i]);
+    daDestroy(&state.filespecRegexes, NULL);
+    friskRegexCachePut(context->regexCache, state.excludeRegex);
+    friskRegexCachePut(context->regexCache, state.pruneRegex);
+    destroyMatchers(&state);
+    daDestroyStrings(&state.patterns);
+    return ret;
+}
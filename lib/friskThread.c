@@ -0,0 +1,385 @@
+#ifdef FRISK_PLATFORM_LINUX
+#define _GNU_SOURCE
+#endif
+
+#include "friskThread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef FRISK_PLATFORM_WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef FRISK_PLATFORM_LINUX
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+struct friskMutex
+{
+#ifdef FRISK_PLATFORM_WIN32
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+};
+
+struct friskCondition
+{
+#ifdef FRISK_PLATFORM_WIN32
+    CONDITION_VARIABLE cond;
+#else
+    pthread_cond_t cond;
+#endif
+};
+
+struct friskThread
+{
+    friskThreadFunc func;
+    void *userData;
+#ifdef FRISK_PLATFORM_WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+};
+
+// ------------------------------------------------------------------------------------------------
+
+friskMutex * friskMutexCreate()
+{
+    friskMutex *mutex = (friskMutex *)calloc(1, sizeof(friskMutex));
+#ifdef FRISK_PLATFORM_WIN32
+    InitializeCriticalSection(&mutex->lock);
+#else
+    pthread_mutex_init(&mutex->lock, NULL);
+#endif
+    return mutex;
+}
+
+void friskMutexDestroy(friskMutex * mutex)
+{
+#ifdef FRISK_PLATFORM_WIN32
+    DeleteCriticalSection(&mutex->lock);
+#else
+    pthread_mutex_destroy(&mutex->lock);
+#endif
+    free(mutex);
+}
+
+void friskMutexLock(friskMutex * mutex)
+{
+#ifdef FRISK_PLATFORM_WIN32
+    EnterCriticalSection(&mutex->lock);
+#else
+    pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+void friskMutexUnlock(friskMutex * mutex)
+{
+#ifdef FRISK_PLATFORM_WIN32
+    LeaveCriticalSection(&mutex->lock);
+#else
+    pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+
+friskCondition * friskConditionCreate()
+{
+    friskCondition *condition = (friskCondition *)calloc(1, sizeof(friskCondition));
+#ifdef FRISK_PLATFORM_WIN32
+    InitializeConditionVariable(&condition->cond);
+#else
+    pthread_cond_init(&condition->cond, NULL);
+#endif
+    return condition;
+}
+
+void friskConditionDestroy(friskCondition * condition)
+{
+#ifndef FRISK_PLATFORM_WIN32
+    pthread_cond_destroy(&condition->cond);
+#endif
+    free(condition);
+}
+
+void friskConditionWait(friskCondition * condition, friskMutex * mutex)
+{
+#ifdef FRISK_PLATFORM_WIN32
+    SleepConditionVariableCS(&condition->cond, &mutex->lock, INFINITE);
+#else
+    pthread_cond_wait(&condition->cond, &mutex->lock);
+#endif
+}
+
+void friskConditionSignal(friskCondition * condition)
+{
+#ifdef FRISK_PLATFORM_WIN32
+    WakeConditionVariable(&condition->cond);
+#else
+    pthread_cond_signal(&condition->cond);
+#endif
+}
+
+void friskConditionBroadcast(friskCondition * condition)
+{
+#ifdef FRISK_PLATFORM_WIN32
+    WakeAllConditionVariable(&condition->cond);
+#else
+    pthread_cond_broadcast(&condition->cond);
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+
+#ifdef FRISK_PLATFORM_WIN32
+static DWORD WINAPI threadMain(LPVOID param)
+{
+    friskThread *thread = (friskThread *)param;
+    thread->func(thread->userData);
+    return 0;
+}
+#else
+static void *threadMain(void *param)
+{
+    friskThread *thread = (friskThread *)param;
+    thread->func(thread->userData);
+    return NULL;
+}
+#endif
+
+friskThread * friskThreadStart(friskThreadFunc func, void * userData)
+{
+    friskThread *thread = (friskThread *)calloc(1, sizeof(friskThread));
+    thread->func = func;
+    thread->userData = userData;
+#ifdef FRISK_PLATFORM_WIN32
+    thread->handle = CreateThread(NULL, 0, threadMain, thread, 0, NULL);
+    if(!thread->handle)
+#else
+    if(pthread_create(&thread->handle, NULL, threadMain, thread))
+#endif
+    {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void friskThreadJoin(friskThread * thread)
+{
+    if(!thread)
+        return;
+#ifdef FRISK_PLATFORM_WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+    free(thread);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+#ifdef FRISK_PLATFORM_LINUX
+// Reads a sysfs cpulist ("0-3,8-11") into cpus, keeping only the ones in allowed
+static int readCpuList(const char *path, const cpu_set_t *allowed, int *cpus, int max)
+{
+    FILE *f = fopen(path, "r");
+    int count = 0;
+    int first;
+    int last;
+    char sep;
+    if(!f)
+        return 0;
+    while(fscanf(f, "%d", &first) == 1)
+    {
+        last = first;
+        sep = (char)fgetc(f);
+        if(sep == '-')
+        {
+            if(fscanf(f, "%d", &last) != 1)
+                break;
+            sep = (char)fgetc(f);
+        }
+        for(; (first <= last) && (count < max); ++first)
+        {
+            if((first < CPU_SETSIZE) && CPU_ISSET(first, allowed))
+                cpus[count++] = first;
+        }
+        if(sep != ',')
+            break;
+    }
+    fclose(f);
+    return count;
+}
+#endif
+
+int friskCpuList(int ** cpus)
+{
+    int count = 0;
+#ifdef FRISK_PLATFORM_WIN32
+    SYSTEM_INFO info;
+    DWORD_PTR processMask;
+    DWORD_PTR systemMask;
+    int i;
+    GetSystemInfo(&info);
+    *cpus = (int *)calloc(info.dwNumberOfProcessors + 1, sizeof(int));
+    if(!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        processMask = (DWORD_PTR)-1;
+    for(i = 0; (i < (int)info.dwNumberOfProcessors) && (i < (int)(sizeof(DWORD_PTR) * 8)); ++i)
+    {
+        if(processMask & ((DWORD_PTR)1 << i))
+            (*cpus)[count++] = i;
+    }
+#elif defined(FRISK_PLATFORM_LINUX)
+    cpu_set_t allowed;
+    int i;
+    *cpus = (int *)calloc(CPU_SETSIZE, sizeof(int));
+    if(!sched_getaffinity(0, sizeof(allowed), &allowed))
+    {
+        for(i = 0; i < CPU_SETSIZE; ++i)
+        {
+            if(CPU_ISSET(i, &allowed))
+                (*cpus)[count++] = i;
+        }
+    }
+#else
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int i;
+    if(online < 1)
+        online = 1;
+    *cpus = (int *)calloc(online, sizeof(int));
+    for(i = 0; i < online; ++i)
+        (*cpus)[count++] = i;
+#endif
+    if(!count)
+        (*cpus)[count++] = 0;
+    return count;
+}
+
+int friskNumaNodes(int *** cpus, int ** nodeSizes)
+{
+    int nodeCount = 0;
+    int nodeCapacity = 8;
+    *cpus = (int **)calloc(nodeCapacity, sizeof(int *));
+    *nodeSizes = (int *)calloc(nodeCapacity, sizeof(int));
+
+#ifdef FRISK_PLATFORM_WIN32
+    {
+        ULONG highest = 0;
+        ULONG node;
+        DWORD_PTR processMask;
+        DWORD_PTR systemMask;
+        if(!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+            processMask = (DWORD_PTR)-1;
+        if(GetNumaHighestNodeNumber(&highest))
+        {
+            for(node = 0; node <= highest; ++node)
+            {
+                ULONGLONG mask = 0;
+                int size = 0;
+                int *nodeCpus;
+                int i;
+                if(!GetNumaNodeProcessorMask((UCHAR)node, &mask))
+                    continue;
+                mask &= processMask;
+                nodeCpus = (int *)calloc(sizeof(ULONGLONG) * 8, sizeof(int));
+                for(i = 0; i < (int)(sizeof(ULONGLONG) * 8); ++i)
+                {
+                    if(mask & ((ULONGLONG)1 << i))
+                        nodeCpus[size++] = i;
+                }
+                if(!size || (nodeCount == nodeCapacity))
+                {
+                    free(nodeCpus);
+                    continue;
+                }
+                (*cpus)[nodeCount] = nodeCpus;
+                (*nodeSizes)[nodeCount] = size;
+                nodeCount++;
+            }
+        }
+    }
+#elif defined(FRISK_PLATFORM_LINUX)
+    {
+        cpu_set_t allowed;
+        DIR *dir = opendir("/sys/devices/system/node");
+        if(dir && !sched_getaffinity(0, sizeof(allowed), &allowed))
+        {
+            struct dirent *entry;
+            while((entry = readdir(dir)) != NULL)
+            {
+                char path[64];
+                int node;
+                int size;
+                int *nodeCpus;
+                if(sscanf(entry->d_name, "node%d", &node) != 1)
+                    continue;
+                snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+                nodeCpus = (int *)calloc(CPU_SETSIZE, sizeof(int));
+                size = readCpuList(path, &allowed, nodeCpus, CPU_SETSIZE);
+                if(!size)
+                {
+                    free(nodeCpus);
+                    continue;
+                }
+                if(nodeCount == nodeCapacity)
+                {
+                    nodeCapacity *= 2;
+                    *cpus = (int **)realloc(*cpus, sizeof(int *) * nodeCapacity);
+                    *nodeSizes = (int *)realloc(*nodeSizes, sizeof(int) * nodeCapacity);
+                }
+                (*cpus)[nodeCount] = nodeCpus;
+                (*nodeSizes)[nodeCount] = size;
+                nodeCount++;
+            }
+        }
+        if(dir)
+            closedir(dir);
+    }
+#endif
+
+    if(!nodeCount)
+    {
+        (*nodeSizes)[0] = friskCpuList(&(*cpus)[0]);
+        nodeCount = 1;
+    }
+    return nodeCount;
+}
+
+int friskThreadPin(const int * cpus, int count)
+{
+#ifdef FRISK_PLATFORM_WIN32
+    DWORD_PTR mask = 0;
+    int i;
+    for(i = 0; i < count; ++i)
+    {
+        if(cpus[i] < (int)(sizeof(DWORD_PTR) * 8))
+            mask |= (DWORD_PTR)1 << cpus[i];
+    }
+    return mask && SetThreadAffinityMask(GetCurrentThread(), mask);
+#elif defined(FRISK_PLATFORM_LINUX)
+    cpu_set_t set;
+    int i;
+    CPU_ZERO(&set);
+    for(i = 0; i < count; ++i)
+    {
+        if(cpus[i] < CPU_SETSIZE)
+            CPU_SET(cpus[i], &set);
+    }
+    return count && !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    // OS X only takes affinity hints, not pins
+    (void)cpus;
+    (void)count;
+    return 0;
+#endif
+}
@@ -0,0 +1,40 @@
+#ifndef FRISKTHREAD_H
+#define FRISKTHREAD_H
+
+// ------------------------------------------------------------------------------------------------
+// The little bit of threading the library needs, over Win32 or pthreads: a mutex, a condition
+// variable, threads that can be joined, and pinning the calling thread to a set of CPUs. All of
+// the handles are opaque.
+
+typedef struct friskMutex friskMutex;
+typedef struct friskCondition friskCondition;
+typedef struct friskThread friskThread;
+
+typedef void (*friskThreadFunc)(void *userData);
+
+friskMutex * friskMutexCreate();
+void friskMutexDestroy(friskMutex * mutex);
+void friskMutexLock(friskMutex * mutex);
+void friskMutexUnlock(friskMutex * mutex);
+
+friskCondition * friskConditionCreate();
+void friskConditionDestroy(friskCondition * condition);
+void friskConditionWait(friskCondition * condition, friskMutex * mutex); // mutex must be locked
+void friskConditionSignal(friskCondition * condition);
+void friskConditionBroadcast(friskCondition * condition);
+
+friskThread * friskThreadStart(friskThreadFunc func, void * userData);
+void friskThreadJoin(friskThread * thread); // also frees it
+
+// Fills in cpus (caller frees) with the CPUs this process may run on, and returns how many.
+int friskCpuList(int ** cpus);
+
+// Fills in cpus (caller frees) with the CPUs on each NUMA node, nodeSizes with how many each has,
+// and returns the node count. Nodes without any usable CPUs are left out; a machine (or platform)
+// without NUMA information comes back as one node holding friskCpuList().
+int friskNumaNodes(int *** cpus, int ** nodeSizes);
+
+// Pins the calling thread to the given CPUs. Returns 0 where that isn't supported.
+int friskThreadPin(const int * cpus, int count);
+
+#endif
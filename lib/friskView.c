@@ -0,0 +1,214 @@
+#include "friskView.h"
+
+#include "dynArray.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ------------------------------------------------------------------------------------------------
+
+static int hitLineCount(friskEntry *entry)
+{
+    return (entry->endLine > entry->line) ? (entry->endLine - entry->line + 1) : 1;
+}
+
+static int entryRowCount(friskEntry *entry)
+{
+    return daSize(&entry->before) + hitLineCount(entry) + daSize(&entry->after);
+}
+
+// Indexes whatever has been added to the list since last time
+static void indexEntries(friskView *view)
+{
+    friskEntry **list = view->context->list;
+    int count = daSize(&list);
+    if(count <= view->entryCount)
+        return;
+
+    if(count + 1 > view->capacity)
+    {
+        view->capacity = (count + 1) * 2;
+        view->rowStarts = (int *)realloc(view->rowStarts, sizeof(int) * view->capacity);
+    }
+    for(; view->entryCount < count; ++view->entryCount)
+        view->rowStarts[view->entryCount + 1] = view->rowStarts[view->entryCount] + entryRowCount(list[view->entryCount]);
+}
+
+// Last entry whose first row is at or before row
+static int findEntry(friskView *view, int row)
+{
+    int low = 0;
+    int high = view->entryCount - 1;
+    while(low < high)
+    {
+        int mid = (low + high + 1) / 2;
+        if(view->rowStarts[mid] <= row)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    return low;
+}
+
+static friskHighlight *reserveHighlights(friskView *view, int count)
+{
+    if(count > view->highlightCapacity)
+    {
+        view->highlightCapacity = count * 2;
+        view->highlights = (friskHighlight *)realloc(view->highlights, sizeof(friskHighlight) * view->highlightCapacity);
+    }
+    return view->highlights;
+}
+
+// Works out one of the lines of a hit: its text, and the highlights that land on it (clipped)
+static void fillMatchRow(friskView *view, friskRow *row, friskEntry *entry, int lineIndex, int *highlightsUsed)
+{
+    const char *match = entry->match ? entry->match : "";
+    const char *start = match;
+    const char *end;
+    int segmentStart;
+    int segmentEnd;
+    int count = daSize(&entry->highlights);
+    int i;
+
+    for(i = 0; (i < lineIndex) && start; ++i)
+    {
+        start = strchr(start, '\n');
+        if(start)
+            start++;
+    }
+    if(!start)
+        start = match + strlen(match);
+    end = strchr(start, '\n');
+    if(!end)
+        end = start + strlen(start);
+    if((end > start) && (end[-1] == '\r'))
+        end--;
+
+    segmentStart = (int)(start - match);
+    segmentEnd = (int)(end - match);
+    row->text = start;
+    row->length = segmentEnd - segmentStart;
+    row->highlightCount = 0;
+
+    // Pointers into view->highlights are set once the whole window is done, as it may move
+    reserveHighlights(view, *highlightsUsed + count);
+    for(i = 0; i < count; ++i)
+    {
+        friskHighlight *highlight = entry->highlights[i];
+        int from = highlight->offset;
+        int to = highlight->offset + highlight->count;
+        friskHighlight *clipped;
+        if(highlight->count ? ((to <= segmentStart) || (from >= segmentEnd)) : ((from < segmentStart) || (from > segmentEnd)))
+            continue;
+        if(from < segmentStart)
+            from = segmentStart;
+        if(to > segmentEnd)
+            to = segmentEnd;
+        clipped = &view->highlights[*highlightsUsed + row->highlightCount++];
+        clipped->offset = from - segmentStart;
+        clipped->count = to - from;
+        clipped->pattern = highlight->pattern;
+    }
+    *highlightsUsed += row->highlightCount;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+friskView * friskViewCreate(friskContext * context)
+{
+    friskView *view = (friskView *)calloc(1, sizeof(friskView));
+    view->context = context;
+    view->capacity = 64;
+    view->rowStarts = (int *)calloc(view->capacity, sizeof(int));
+    return view;
+}
+
+void friskViewDestroy(friskView * view)
+{
+    free(view->rowStarts);
+    free(view->rows);
+    free(view->highlights);
+    free(view);
+}
+
+int friskViewRowCount(friskView * view)
+{
+    indexEntries(view);
+    return view->rowStarts[view->entryCount];
+}
+
+int friskViewGetRows(friskView * view, int first, int count, friskRow ** rows)
+{
+    friskEntry **list = view->context->list;
+    int total = friskViewRowCount(view);
+    int highlightsUsed = 0;
+    int entryIndex;
+    int i;
+
+    *rows = NULL;
+    if(first < 0)
+    {
+        count += first;
+        first = 0;
+    }
+    if(count > total - first)
+        count = total - first;
+    if(count <= 0)
+        return 0;
+
+    if(count > view->rowCapacity)
+    {
+        view->rowCapacity = count;
+        view->rows = (friskRow *)realloc(view->rows, sizeof(friskRow) * view->rowCapacity);
+    }
+
+    entryIndex = findEntry(view, first);
+    for(i = 0; i < count; ++i)
+    {
+        friskRow *row = &view->rows[i];
+        friskEntry *entry;
+        int local;
+        int beforeCount;
+        int lineCount;
+
+        while(first + i >= view->rowStarts[entryIndex + 1])
+            entryIndex++;
+        entry = list[entryIndex];
+        local = first + i - view->rowStarts[entryIndex];
+        beforeCount = daSize(&entry->before);
+        lineCount = hitLineCount(entry);
+
+        memset(row, 0, sizeof(friskRow));
+        row->filename = entry->filename;
+        row->entry = entryIndex;
+        if(local < beforeCount)
+        {
+            row->text = entry->before[local];
+            row->length = (int)strlen(row->text);
+            row->line = entry->line - beforeCount + local;
+            row->isContext = 1;
+        }
+        else if(local < beforeCount + lineCount)
+        {
+            row->line = entry->line + (local - beforeCount);
+            fillMatchRow(view, row, entry, local - beforeCount, &highlightsUsed);
+        }
+        else
+        {
+            row->text = entry->after[local - beforeCount - lineCount];
+            row->length = (int)strlen(row->text);
+            row->line = entry->line + lineCount + (local - beforeCount - lineCount);
+            row->isContext = 1;
+        }
+    }
+
+    highlightsUsed = 0;
+    for(i = 0; i < count; ++i)
+    {
+        view->rows[i].highlights = view->rows[i].highlightCount ? &view->highlights[highlightsUsed] : NULL;
+        highlightsUsed += view->rows[i].highlightCount;
+    }
+    *rows = view->rows;
+    return count;
+}
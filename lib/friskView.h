@@ -0,0 +1,48 @@
+#ifndef FRISKVIEW_H
+#define FRISKVIEW_H
+
+#include "friskContext.h"
+
+// ------------------------------------------------------------------------------------------------
+// Row-addressed window over context->list, so a frontend only ever has to render what's on
+// screen. Every entry is one row per line it covers plus a row per context line, in list order.
+// The view keeps the first row of every entry (one int each) and works out the rows themselves
+// only when they're asked for. Entries added to the list since the last call are picked up on the
+// next one, so a view can be used while the search is still running. A view covers one search;
+// make a new one after the next friskContextSearch() clears the list.
+
+typedef struct friskRow
+{
+    const char * filename;
+    const char * text;          // not NUL terminated; a multiline hit is split into one row per line
+    int length;
+    int line;
+    int isContext;
+    int entry;                  // index into context->list
+    friskHighlight * highlights; // clipped to this row, offsets relative to text
+    int highlightCount;
+} friskRow;
+
+typedef struct friskView
+{
+    friskContext * context;
+    int * rowStarts;            // rowStarts[i] is the first row of list[i]; one extra at the end
+    int entryCount;             // how much of the list rowStarts covers
+    int capacity;
+    friskRow * rows;            // the last window handed out
+    int rowCapacity;
+    friskHighlight * highlights;
+    int highlightCapacity;
+} friskView;
+
+friskView * friskViewCreate(friskContext * context);
+void friskViewDestroy(friskView * view);
+
+// Total rows, counting any entries added since the last call.
+int friskViewRowCount(friskView * view);
+
+// Points *rows at rows first .. first + count - 1 (clipped to what exists) and returns how many
+// there are. They belong to the view and last until the next call.
+int friskViewGetRows(friskView * view, int first, int count, friskRow ** rows);
+
+#endif
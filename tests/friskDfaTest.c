@@ -0,0 +1,90 @@
+#include "friskDfa.h"
+
+#include <pcre.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+// Every hit the DFA finds in text, start to end, has to be the one pcre_exec finds. A pattern the
+// DFA refuses is fine unless mustBuild is set.
+static void expectSameHits(const char *pattern, const char *text, int mustBuild)
+{
+    const char *error;
+    int erroffset;
+    pcre *regex = pcre_compile(pattern, 0, &error, &erroffset, NULL);
+    friskDfa *dfa = friskDfaCreate(pattern, 0, FRISK_DFA_MEMORY_LIMIT);
+    int len = (int)strlen(text);
+    int start = 0;
+
+    if(!regex)
+    {
+        printf("FAIL: \"%s\" doesn't compile: %s\n", pattern, error);
+        failures++;
+        return;
+    }
+    if(!dfa)
+    {
+        if(mustBuild)
+        {
+            printf("FAIL: \"%s\" should be handled by the DFA\n", pattern);
+            failures++;
+        }
+        pcre_free(regex);
+        return;
+    }
+
+    while(start <= len)
+    {
+        int ovector[30];
+        int matchPos = -1;
+        int matchLen = -1;
+        int rc = pcre_exec(regex, NULL, text, len, start, 0, ovector, 30);
+        int dfaRc = friskDfaFind(dfa, text, len, start, &matchPos, &matchLen);
+        if((rc < 0) && (dfaRc == 0))
+            break;
+        if((rc < 0) || (dfaRc != 1) || (matchPos != ovector[0]) || (matchLen != ovector[1] - ovector[0]))
+        {
+            printf("FAIL: \"%s\" in \"%s\" from %d: PCRE [%d,%d], DFA rc %d [%d,%d]\n", pattern, text, start,
+                (rc < 0) ? -1 : ovector[0], (rc < 0) ? -1 : ovector[1] - ovector[0], dfaRc, matchPos, matchLen);
+            failures++;
+            break;
+        }
+        start = ovector[1] + ((ovector[1] == ovector[0]) ? 1 : 0);
+    }
+    friskDfaDestroy(dfa);
+    pcre_free(regex);
+}
+
+int main(int argc, char **argv)
+{
+    const char *texts[] = { ".bx", "aaa.b", "x c xx", " \t x", "bbbA", "abcabc", "", NULL };
+    const char *patterns[] = {
+        // Loops whose body can match empty
+        "(a?|\\.)*", "(x??|c)*", "(\\s?|x*)*", "(b?|.*)*A", "(a|)*b", "(^|a)*", "(a*)+", "(?:a?)*?b",
+        // Bounded and optional repeats of the same are fine
+        "(a?|\\.){0,3}", "(a?|\\.)?", "(x??|c){2}",
+        NULL
+    };
+    const char *handled[] = { "a+b", "[a-c]+", "(ab|a)c*", "x*?c", "^a.*b$", "(?:ab){1,2}", "\\d+|\\w+", NULL };
+    int i;
+    int j;
+    (void)argc;
+    (void)argv;
+
+    for(i = 0; patterns[i]; ++i)
+    {
+        for(j = 0; texts[j]; ++j)
+            expectSameHits(patterns[i], texts[j], 0);
+    }
+    for(i = 0; handled[i]; ++i)
+    {
+        for(j = 0; texts[j]; ++j)
+            expectSameHits(handled[i], texts[j], 1);
+    }
+
+    if(failures)
+        printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#include "friskMultiRegex.h"
+
+#include "dynArray.h"
+#include "dynString.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+// Searches text with patterns (NULL terminated) and checks the first hit
+static void expectHit(const char **patterns, const char *text, int expectedPos, int expectedLen, int expectedPattern)
+{
+    char **list = NULL;
+    char *error = NULL;
+    friskMultiRegex *multiRegex;
+    int matchPos = -1;
+    int matchLen = -1;
+    int pattern = -1;
+    int rc;
+    int i;
+
+    for(i = 0; patterns[i]; ++i)
+        daPush(&list, dsDup(patterns[i]));
+    multiRegex = friskMultiRegexCreate(list, 0, 0, 0, &error);
+    daDestroyStrings(&list);
+    if(!multiRegex)
+    {
+        printf("FAIL: %s: %s\n", patterns[0], error);
+        dsDestroy(&error);
+        failures++;
+        return;
+    }
+
+    rc = friskMultiRegexFind(multiRegex, text, (int)strlen(text), 0, &matchPos, &matchLen, &pattern);
+    if((rc != 1) || (matchPos != expectedPos) || (matchLen != expectedLen) || (pattern != expectedPattern))
+    {
+        printf("FAIL: \"%s\" in \"%s\": got rc %d [%d,%d] pattern %d, expected [%d,%d] pattern %d\n",
+            patterns[i - 1], text, rc, matchPos, matchLen, pattern, expectedPos, expectedLen, expectedPattern);
+        failures++;
+    }
+    friskMultiRegexDestroy(multiRegex);
+}
+
+int main(int argc, char **argv)
+{
+    const char *plain[] = { "zz", "b(c+)", "a+", NULL };
+    const char *subroutine[] = { "zz", "(ab)(?1)", NULL };
+    const char *relative[] = { "zz", "(ab)(?-1)", NULL };
+    const char *recursion[] = { "zz", "\\((?:[^()]|(?R))*\\)", NULL };
+    const char *named[] = { "zz", "(?<x>ab)(?&x)", "(?P<y>cd)(?P>y)", NULL };
+    const char *conditional[] = { "zz", "(a)?(?(1)b|c)", NULL };
+    const char *backref[] = { "zz", "(ab)\\1", NULL };
+    const char *quoted[] = { "zz", "\\Q(?1)\\E", NULL };
+    const char *extended[] = { "(?x)foo # c", "bar", NULL };
+    const char *verb[] = { "(*CR)foo", "bar", NULL };
+    (void)argc;
+    (void)argv;
+
+    expectHit(plain, "xx aabccc", 3, 2, 2);
+    expectHit(plain, "xx bccc", 3, 4, 1);
+    expectHit(subroutine, "xx abab zz", 3, 4, 1);
+    expectHit(relative, "xx abab zz", 3, 4, 1);
+    expectHit(recursion, "x (a(b)c) zz", 2, 7, 1);
+    expectHit(named, "xx cdcd zz", 3, 4, 2);
+    expectHit(conditional, "xx ab zz", 3, 2, 1);
+    expectHit(backref, "xx abab zz", 3, 4, 1);
+    expectHit(quoted, "xx (?1) zz", 3, 4, 1);
+    expectHit(extended, "xx bar foo", 3, 3, 1);
+    expectHit(extended, "xx foo bar", 3, 3, 0);
+    expectHit(verb, "xx bar foo", 3, 3, 1);
+    expectHit(verb, "xx foo bar", 3, 3, 0);
+
+    if(failures)
+        printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+#include "friskContext.h"
+
+#include "dynArray.h"
+#include "dynString.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define makeDirectory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define makeDirectory(path) mkdir(path, 0755)
+#endif
+
+#define DATA_DIR "friskSearchTestData"
+
+static int failures = 0;
+
+// A ustar archive holding one file
+static void writeTar(const char *filename, const char *entryName, const char *text)
+{
+    char tar[512 * 4];
+    int length = (int)strlen(text);
+    unsigned int checksum = 0;
+    int i;
+
+    memset(tar, 0, sizeof(tar));
+    strcpy(tar, entryName);
+    strcpy(tar + 100, "0000644");
+    sprintf(tar + 124, "%011o", length);
+    strcpy(tar + 136, "00000000000");
+    tar[156] = '0';
+    memcpy(tar + 257, "ustar", 6);
+    memcpy(tar + 263, "00", 2);
+    memset(tar + 148, ' ', 8);
+    for(i = 0; i < 512; ++i)
+        checksum += (unsigned char)tar[i];
+    sprintf(tar + 148, "%06o", checksum);
+    memcpy(tar + 512, text, length);
+    friskWriteEntireFile(filename, tar, (int)sizeof(tar));
+}
+
+// Searches DATA_DIR for "hello" through archives and checks which files it was found in
+static void expectFiles(const char *filespec, const char *excludeFilespec, const char *expected)
+{
+    friskContext *context = friskContextCreate();
+    friskParams *params = context->params;
+    char *found = NULL;
+    int i;
+
+    daPush(&params->paths, dsDup(DATA_DIR));
+    if(filespec)
+        daPush(&params->filespecs, dsDup(filespec));
+    if(excludeFilespec)
+        daPush(&params->excludeFilespecs, dsDup(excludeFilespec));
+    dsCopy(&params->match, "hello");
+    params->threads = 1;
+    params->flags = FSF_RECURSIVE | FSF_ARCHIVES;
+
+    if(!friskContextSearch(context))
+    {
+        printf("FAIL: search didn't start: %s\n", context->error);
+        failures++;
+        friskContextDestroy(context);
+        return;
+    }
+
+    // One thread, but the reader can still finish files out of order
+    for(i = 0; i < daSize(&context->list); ++i)
+    {
+        if(strstr(context->list[i]->filename, "arc.tar"))
+            dsConcat(&found, "A");
+    }
+    for(i = 0; i < daSize(&context->list); ++i)
+    {
+        if(strstr(context->list[i]->filename, "b.txt"))
+            dsConcat(&found, "B");
+    }
+    if(strcmp(found ? found : "", expected))
+    {
+        printf("FAIL: filespec %s, exclude %s: found \"%s\", expected \"%s\"\n",
+            filespec ? filespec : "(none)", excludeFilespec ? excludeFilespec : "(none)", found ? found : "", expected);
+        failures++;
+    }
+    dsDestroy(&found);
+    friskContextDestroy(context);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    makeDirectory(DATA_DIR);
+    writeTar(DATA_DIR "/arc.tar", "a.txt", "hello\n");
+    friskWriteEntireFile(DATA_DIR "/b.txt", "hello\n", 6);
+
+    expectFiles(NULL, NULL, "AB");
+    expectFiles(NULL, "*.tar", "B");       // excludes apply to the archive itself
+    expectFiles("*.txt", NULL, "AB");      // filespecs apply to its entries
+    expectFiles("*.txt", "*.tar", "B");
+    expectFiles(NULL, "a.txt", "B");       // ... and so do excludes
+
+    if(failures)
+        printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}